@@ -0,0 +1,84 @@
+
+#include "lcd_kern.h" // kern_fill16
+#include "compositor.h"
+
+static void draw_line(void *arg, color_t *line, coord_t x, coord_t y, coord_t n)
+{
+	compositor_line(arg, line, x, y, n);
+}
+
+// Initialize a compositor with no sprites visible.
+// *c: pointer to compositor.
+// *bg: background layer, or NULL for a solid background.
+// back: background color used when there is no layer.
+void compositor_init(compositor_t *c, const tilemap_t *bg, color_t back)
+{
+	*c = (compositor_t){.bg = bg, .back = back, .overflow_y = -1};
+}
+
+// Set up a sprite in the table. Lower table entries are drawn on top.
+// *c: pointer to compositor.
+// i: table entry, 0 to COMP_SPRITES-1.
+// *image: RGB565 image, referenced, not copied.
+// w: image width in pixels.
+// h: image height in pixels.
+// key: image color that is transparent.
+void compositor_set_sprite(compositor_t *c, uint32_t i, const color_t *image, uint16_t w, uint16_t h, color_t key)
+{
+	if (i >= COMP_SPRITES) return;
+	comp_sprite_t *s = &c->sprite[i];
+	s->image = image;
+	s->w = w;
+	s->h = h;
+	s->key = key;
+}
+
+// Compose n pixels of screen row y starting at column x.
+// *c: pointer to compositor.
+// *line: receives n colors.
+// x: screen X coordinate.
+// y: screen Y coordinate.
+// n: number of pixels.
+void compositor_line(compositor_t *c, color_t *line, coord_t x, coord_t y, coord_t n)
+{
+	const comp_sprite_t *sel[COMP_LINE_SPRITES];
+	uint32_t cnt = 0;
+
+	// Sprite evaluation: the first sprites in the table that cover the
+	// requested columns of the row. A row may be requested in pieces, so
+	// overflow is counted once per row.
+	for (uint32_t i = 0; i < COMP_SPRITES; i++) {
+		const comp_sprite_t *s = &c->sprite[i];
+		if (!s->visible || y < s->y || y >= s->y+s->h) continue;
+		if (x >= s->x+s->w || s->x >= x+n) continue;
+		if (cnt == COMP_LINE_SPRITES) {
+			if (y != c->overflow_y) c->overflow++;
+			c->overflow_y = y;
+			break;
+		}
+		sel[cnt++] = s;
+	}
+
+	if (c->bg != NULL) tilemap_line(c->bg, line, x, y, n);
+	else kern_fill16(line, c->back, n);
+
+	// Draw back to front so earlier sprites end up on top.
+	while (cnt) {
+		const comp_sprite_t *s = sel[--cnt];
+		coord_t x0 = (s->x > x) ? s->x : x; // clip to the requested columns
+		coord_t x1 = (s->x+s->w < x+n) ? s->x+s->w : x+n;
+		const color_t *src = s->image + (size_t)(y-s->y)*s->w + (x0-s->x);
+		color_t *dst = line + (x0-x);
+		for (coord_t i = 0; i < x1-x0; i++) {
+			if (src[i] != s->key) dst[i] = src[i];
+		}
+	}
+}
+
+// Compose and send the whole screen, line by line.
+// *c: pointer to compositor.
+void compositor_draw(compositor_t *c)
+{
+	c->overflow_y = -1;
+	lcd_drawLines(0, 0, LCD_W, LCD_H, draw_line, c);
+}
@@ -0,0 +1,71 @@
+#ifndef COMPOSITOR_H_
+#define COMPOSITOR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lcd.h" // coord_t, color_t
+#include "tilemap.h"
+
+// This component builds each display line on demand from a tilemap layer
+// and a table of sprites, the way a console video chip does, so a full
+// screen of animation needs no frame buffer. For every line, the sprite
+// table is searched in order for sprites that cover the requested part of
+// the line, and the first COMP_LINE_SPRITES found are drawn over the
+// background, earlier sprites on top. Sprites past that limit are dropped
+// from the line, and the line is counted in overflow.
+//
+// compositor_draw() sends the screen through lcd_drawLines(), which in
+// direct mode fills one of two small DMA buffers while the other is sent.
+// The screen is written top to bottom in one pass, so each line is
+// complete when it reaches the panel. The host directory has a build for
+// a PC that writes frames to PPM files and reports the time per line.
+
+#define COMP_SPRITES 64     // Sprites in the sprite table
+#define COMP_LINE_SPRITES 8 // Sprites drawn on one line
+
+typedef struct {
+	const color_t *image; // RGB565 colors, w*h, row by row
+	coord_t x, y;         // screen position of the top left corner
+	uint16_t w, h;        // size in pixels
+	color_t key;          // image color that is transparent
+	bool visible;
+} comp_sprite_t;
+
+typedef struct {
+	const tilemap_t *bg;  // background layer, or NULL
+	color_t back;         // background color without a layer
+	comp_sprite_t sprite[COMP_SPRITES];
+	uint32_t overflow;    // lines with sprites dropped, since cleared
+	coord_t overflow_y;   // row last counted in overflow
+} compositor_t;
+
+
+// Initialize a compositor with no sprites visible.
+// *c: pointer to compositor.
+// *bg: background layer, or NULL for a solid background.
+// back: background color used when there is no layer.
+void compositor_init(compositor_t *c, const tilemap_t *bg, color_t back);
+
+// Set up a sprite in the table. Lower table entries are drawn on top.
+// *c: pointer to compositor.
+// i: table entry, 0 to COMP_SPRITES-1.
+// *image: RGB565 image, referenced, not copied.
+// w: image width in pixels.
+// h: image height in pixels.
+// key: image color that is transparent.
+void compositor_set_sprite(compositor_t *c, uint32_t i, const color_t *image, uint16_t w, uint16_t h, color_t key);
+
+// Compose n pixels of screen row y starting at column x.
+// *c: pointer to compositor.
+// *line: receives n colors.
+// x: screen X coordinate.
+// y: screen Y coordinate.
+// n: number of pixels.
+void compositor_line(compositor_t *c, color_t *line, coord_t x, coord_t y, coord_t n);
+
+// Compose and send the whole screen, line by line.
+// *c: pointer to compositor.
+void compositor_draw(compositor_t *c);
+
+#endif // COMPOSITOR_H_
@@ -0,0 +1,122 @@
+// Host (PC) build of the compositor. lcd_drawLines() is replaced by one
+// that composes into an image in memory, times each line, and the image
+// is written as a PPM file. A demo scene scrolls a tilemap under bouncing
+// sprites.
+// Usage: compositor_host [frames [ppm_every]]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "compositor.h"
+
+#define TILE_SZ 16
+#define TILE_CNT 4
+#define MAP_W 40 // map size in tiles, larger than the screen
+#define MAP_H 30
+#define BALLS 24
+#define BALL_SZ 24
+
+static color_t image[LCD_H][LCD_W];
+static double line_ns, line_max_ns;
+static uint32_t line_cnt;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+// Stand-in for the LCD: compose into the image and time each line.
+void lcd_drawLines(coord_t x, coord_t y, coord_t w, coord_t h, lcd_line_t line, void *arg)
+{
+	for (coord_t r = 0; r < h; r++) {
+		double t0 = now_ns();
+		line(arg, &image[y+r][x], 0, r, w);
+		double t = now_ns() - t0;
+		line_ns += t;
+		if (t > line_max_ns) line_max_ns = t;
+		line_cnt++;
+	}
+}
+
+static void write_ppm(const char *name)
+{
+	FILE *f = fopen(name, "wb");
+	if (f == NULL) {
+		perror(name);
+		return;
+	}
+	fprintf(f, "P6\n%d %d\n255\n", LCD_W, LCD_H);
+	for (coord_t y = 0; y < LCD_H; y++) {
+		for (coord_t x = 0; x < LCD_W; x++) {
+			color_t c = image[y][x];
+			uint8_t rgb[3] = {(c >> 11) << 3, ((c >> 5) & 0x3F) << 2, (c & 0x1F) << 3};
+			fwrite(rgb, 1, 3, f);
+		}
+	}
+	fclose(f);
+}
+
+int main(int argc, char *argv[])
+{
+	static color_t tiles[TILE_CNT*TILE_SZ*TILE_SZ];
+	static uint16_t map[MAP_W*MAP_H];
+	static color_t ball[BALL_SZ*BALL_SZ];
+	color_t ctab[TILE_CNT] = {BLUE, GREEN, CYAN, MAGENTA};
+	coord_t vx[BALLS], vy[BALLS];
+	tilemap_t tm;
+	compositor_t comp;
+	int frames = (argc > 1) ? atoi(argv[1]) : 60;
+	int every = (argc > 2) ? atoi(argv[2]) : 20;
+
+	for (int t = 0; t < TILE_CNT; t++) {
+		for (int i = 0; i < TILE_SZ*TILE_SZ; i++) {
+			int r = i / TILE_SZ, c = i % TILE_SZ;
+			tiles[t*TILE_SZ*TILE_SZ+i] = (r == 0 || c == 0) ? GRAY : ctab[t];
+		}
+	}
+	srand(1);
+	for (int i = 0; i < MAP_W*MAP_H; i++) map[i] = rand() % TILE_CNT;
+	for (int i = 0; i < BALL_SZ*BALL_SZ; i++) {
+		int dx = 2*(i % BALL_SZ) - BALL_SZ + 1, dy = 2*(i / BALL_SZ) - BALL_SZ + 1;
+		int d2 = dx*dx + dy*dy;
+		ball[i] = (d2 > BALL_SZ*BALL_SZ) ? BLACK : (d2 < BALL_SZ*BALL_SZ/8) ? WHITE : RED;
+	}
+
+	tilemap_init(&tm, map, MAP_W, MAP_H, TILE_SZ);
+	tilemap_set_tiles(&tm, tiles);
+	compositor_init(&comp, &tm, BLACK);
+	for (int i = 0; i < BALLS; i++) {
+		comp_sprite_t *s = &comp.sprite[i];
+		compositor_set_sprite(&comp, i, ball, BALL_SZ, BALL_SZ, BLACK);
+		s->x = rand() % (LCD_W-BALL_SZ);
+		s->y = rand() % (LCD_H-BALL_SZ);
+		s->visible = true;
+		vx[i] = rand() % 7 - 3;
+		vy[i] = rand() % 5 + 1;
+	}
+
+	for (int f = 0; f < frames; f++) {
+		tilemap_scroll(&tm, f, f/2);
+		for (int i = 0; i < BALLS; i++) {
+			comp_sprite_t *s = &comp.sprite[i];
+			s->x += vx[i];
+			s->y += vy[i];
+			if (s->x < 0 || s->x > LCD_W-BALL_SZ) vx[i] = -vx[i];
+			if (s->y < 0 || s->y > LCD_H-BALL_SZ) vy[i] = -vy[i];
+		}
+		compositor_draw(&comp);
+		if (every > 0 && f % every == 0) {
+			char name[32];
+			snprintf(name, sizeof(name), "frame_%03d.ppm", f);
+			write_ppm(name);
+		}
+	}
+
+	printf("frames:%d lines:%u\n", frames, line_cnt);
+	printf("us per line: mean %.3f max %.3f\n", line_ns/line_cnt/1e3, line_max_ns/1e3);
+	printf("lines with dropped sprites:%u\n", comp.overflow);
+	return 0;
+}
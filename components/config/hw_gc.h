@@ -52,6 +52,7 @@
 #define HW_LCD_H 240
 #define HW_LCD_OFFSETX 0
 #define HW_LCD_OFFSETY 0
+#define HW_LCD_GATE_LINES 240 // frame memory rows covered by vertical scroll
 
 #define HW_LCD_DRIVER 0
 
@@ -0,0 +1,14 @@
+// Host stand-in for the ESP-IDF header, only what lcd.c uses.
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef int gpio_num_t;
+typedef int gpio_mode_t;
+
+#define GPIO_MODE_OUTPUT 2
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num);
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
@@ -0,0 +1,12 @@
+// Host stand-in for the ESP-IDF header, only what lcd.c uses.
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_DMA  (1<<3)
+#define MALLOC_CAP_8BIT (1<<2)
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
@@ -0,0 +1,11 @@
+// Host stand-in for the ESP-IDF header. Errors and warnings go to stderr,
+// the rest is dropped so it doesn't mix with the benchmark output.
+#pragma once
+
+#include <stdio.h>
+#include <inttypes.h>
+
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do {} while (0)
+#define ESP_LOGD(tag, fmt, ...) do {} while (0)
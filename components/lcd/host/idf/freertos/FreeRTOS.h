@@ -0,0 +1,13 @@
+// Host stand-in for the ESP-IDF header, only what lcd.c uses.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+typedef uint32_t TickType_t;
+
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_PERIOD_MS 1
+#define IRAM_ATTR
@@ -0,0 +1,6 @@
+// Host stand-in for the ESP-IDF header, only what lcd.c uses.
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+void vTaskDelay(TickType_t ticks);
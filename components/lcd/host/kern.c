@@ -0,0 +1,112 @@
+// Host (PC) check and micro-benchmark of the lcd_kern.c kernels. Each
+// kernel is compared bit for bit with the per-pixel loop it replaced at
+// every destination and source alignment, then both are timed over a
+// full frame.
+// Usage: kern_host [repeats]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lcd.h" // LCD_W, LCD_H, colors
+#include "lcd_kern.h"
+
+#define CHECK_LEN 67 // spans checked, 0 to CHECK_LEN elements
+#define FRAME_LEN (LCD_W*LCD_H)
+
+static uint16_t src[CHECK_LEN+4], ref[CHECK_LEN+4], out[CHECK_LEN+4];
+static uint16_t frame[FRAME_LEN+2], frame2[FRAME_LEN+2];
+
+static uint16_t swap16(uint16_t c)
+{
+	return (c << 8) | (c >> 8);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9 + ts.tv_nsec;
+}
+
+// Compare out with ref and clear both for the next case.
+static uint32_t compare(void)
+{
+	uint32_t bad = memcmp(ref, out, sizeof(ref)) != 0;
+	memset(ref, 0, sizeof(ref));
+	memset(out, 0, sizeof(out));
+	return bad;
+}
+
+static uint32_t check(void)
+{
+	uint32_t errors = 0;
+
+	srand(1);
+	for (int32_t i = 0; i < CHECK_LEN+4; i++) src[i] = rand();
+	for (int32_t off = 0; off < 2; off++) {
+		for (int32_t n = 0; n <= CHECK_LEN; n++) {
+			uint16_t c = rand();
+			for (int32_t i = 0; i < n; i++) ref[off+i] = c;
+			kern_fill16(out+off, c, n);
+			errors += compare();
+
+			for (int32_t j = 0; j < 3; j++) {
+				for (int32_t i = 0; i < n/3; i++) ref[off+j*(n/3+1)+i] = c;
+			}
+			kern_fill_rect16(out+off, n/3+1, n/3, 3, c);
+			errors += compare();
+
+			for (int32_t soff = 0; soff < 2; soff++) {
+				for (int32_t i = 0; i < n; i++) ref[off+i] = src[soff+i];
+				kern_copy16(out+off, src+soff, n);
+				errors += compare();
+
+				for (int32_t i = 0; i < n; i++) ref[off+i] = swap16(src[soff+i]);
+				kern_copy16_swap(out+off, src+soff, n);
+				errors += compare();
+
+				for (int32_t i = 0; i < n; i++) ref[off+i] = swap16(src[soff+i]);
+				memcpy(out+off, src+soff, n*sizeof(uint16_t));
+				kern_copy16_swap(out+off, out+off, n); // in place
+				errors += compare();
+			}
+		}
+	}
+	return errors;
+}
+
+int main(int argc, char *argv[])
+{
+	int reps = (argc > 1) ? atoi(argv[1]) : 200;
+	double t0, loop_ns, kern_ns;
+	uint32_t errors = check();
+
+	if (reps <= 0) reps = 200;
+	printf("mismatches:%u\n", errors);
+
+	// volatile keeps the compiler from turning the loops into the kernels
+	volatile uint16_t *vf = frame;
+	t0 = now_ns();
+	for (int r = 0; r < reps; r++) {
+		for (int32_t i = 0; i < FRAME_LEN; i++) vf[i+1] = BLUE;
+	}
+	loop_ns = (now_ns() - t0)/reps;
+	t0 = now_ns();
+	for (int r = 0; r < reps; r++) kern_fill16(frame+1, (uint16_t)(GREEN+r), FRAME_LEN);
+	kern_ns = (now_ns() - t0)/reps;
+	printf("fill  us per frame: loop %.1f kernel %.1f\n", loop_ns/1e3, kern_ns/1e3);
+
+	t0 = now_ns();
+	for (int r = 0; r < reps; r++) {
+		for (int32_t i = 0; i < FRAME_LEN; i++) vf[i] = swap16(frame2[i]);
+	}
+	loop_ns = (now_ns() - t0)/reps;
+	t0 = now_ns();
+	for (int r = 0; r < reps; r++) kern_copy16_swap(frame, frame2+(r & 1), FRAME_LEN);
+	kern_ns = (now_ns() - t0)/reps;
+	printf("swap  us per frame: loop %.1f kernel %.1f\n", loop_ns/1e3, kern_ns/1e3);
+
+	return errors != 0;
+}
@@ -0,0 +1,62 @@
+// Host (PC) build of the damage tracking replay from test_lcd. lcd.c runs
+// against stand-ins for the ESP-IDF SPI and GPIO calls (idf.c), and the
+// bytes and transactions it queues are reported per frame for each
+// damage tracking mode, against a full frame push (none).
+// Usage: replay_host [frames]
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lcd.h"
+
+#define REPLAY_OBJS 10
+
+int main(int argc, char *argv[])
+{
+	static const char *mtab[] = {"none", "rect", "tile"};
+	int frames = (argc > 1) ? atoi(argv[1]) : 100;
+	const coord_t width = LCD_W, height = LCD_H;
+	frame_stats_t stats;
+
+	if (frames <= 0) frames = 100;
+	lcd_init();
+	lcd_frameEnable();
+	if (lcd_getFrameBuffer() == NULL) {
+		fprintf(stderr, "no frame buffer\n");
+		return 1;
+	}
+
+	for (damage_t mode = DAMAGE_NONE; mode <= DAMAGE_TILE; mode++) {
+		coord_t x0[REPLAY_OBJS], x1[REPLAY_OBJS], y1[REPLAY_OBJS];
+		uint64_t bytes = 0, trans = 0;
+
+		srand(1); // same sequence for each mode
+		for (int32_t i = 0; i < REPLAY_OBJS; i++) {
+			x0[i] = rand() % width;
+			x1[i] = rand() % width;
+			y1[i] = height/2 + rand() % (height/2);
+		}
+		lcd_frameDamageMode(mode);
+		lcd_fillScreen(BLACK);
+		lcd_writeFrame();
+
+		for (int32_t f = 1; f <= frames; f++) {
+			for (int32_t i = 0; i < REPLAY_OBJS; i++) {
+				coord_t xe = x0[i] + (x1[i]-x0[i]) * f / frames;
+				coord_t ye = y1[i] * f / frames;
+				if (i & 1) lcd_drawLine(x0[i], 0, xe, ye, RED);
+				else lcd_fillCircle(x1[i], y1[i], f % 25, (f % 25) ? YELLOW : BLACK);
+			}
+			lcd_drawHLine(f*3 % width - 3, height/3, 7, WHITE);
+			lcd_writeFrame();
+			lcd_getFrameStats(&stats);
+			bytes += stats.bytes;
+			trans += stats.trans;
+		}
+
+		printf("%s: bytes per frame:%lu, transactions per frame:%lu\n",
+			mtab[mode], (unsigned long)(bytes/frames), (unsigned long)(trans/frames));
+	}
+	lcd_frameDisable();
+	return 0;
+}
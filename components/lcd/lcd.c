@@ -6,7 +6,7 @@
 //   https://github.com/adafruit/Adafruit_ILI9341
 
 #include <string.h> // strlen, memcpy
-#include <math.h> // cosf, sinf
+#include <math.h> // sqrtf
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -18,9 +18,14 @@
 
 #include "hw.h"
 #include "lcd.h"
+#include "lcd_kern.h"
 
 #define _DEBUG_ 0
 
+// 1: queue direct drawing as one batch of transactions per primitive.
+// 0: poll each transaction, the original method, for comparison.
+#define DIRECT_QUEUE 1
+
 #define LCD_MOSI HW_LCD_MOSI
 #define LCD_SCLK HW_LCD_SCLK
 #define LCD_CS   HW_LCD_CS
@@ -37,15 +42,78 @@
 
 #define LCD_DRIVER HW_LCD_DRIVER
 
+#define LCD_GATE_LINES HW_LCD_GATE_LINES
+
 #define swap(T,a,b) {T t = (a); (a) = (b); (b) = t;}
 
 #define M_PIf 3.14159265358979323846f
 
 #define SWAP16(c) (((c) << 8) | ((c) >> 8))
 
+// Color as stored in the frame buffer.
+#define FB_COLOR(c) (dev->frame_swap ? (color_t)SWAP16(c) : (c))
+
+// Rectangle with inclusive corners.
+typedef struct {
+	coord_t x0;
+	coord_t y0;
+	coord_t x1;
+	coord_t y1;
+} rect_t;
+
+#define DAMAGE_MAX   16 // changed regions tracked before forced merging
+#define DAMAGE_SLACK 64 // pixels of overdraw accepted to save a window
+#define DAMAGE_FULL  50 // percent of frame area that forces a full push
+#define TILE_SIZE    16 // tile width and height in pixels for DAMAGE_TILE
+
+#define PAL_MAX 256 // palette entries for the indexed frame buffer
+#define SPAN_MAX 8  // pending spans held for write-combining
+#define GLYPH_SLOTS    128 // cached glyph cells, power of 2
+#define GLYPH_SIZE_MAX 2   // largest font size with cached glyph cells
+#define CIRCLE_CACHE_R 31  // largest radius with a cached width table, < 32
+#define CIRCLE_CACHE_LEN ((CIRCLE_CACHE_R+1)*(CIRCLE_CACHE_R+2)/2)
+
+// Single color rectangle waiting to be written in direct mode.
+typedef struct {
+	rect_t  r;
+	color_t color;
+} span_t;
+
+// Character expanded to colors at one font size, row-major.
+typedef struct {
+	color_t *cell;
+	uint16_t cap;   // cell capacity in pixels
+	uint8_t  size;  // font size, 0 if the slot is empty
+	uint8_t  dir;   // font direction the cell is rotated to
+	char     ascii;
+	color_t  fg;
+	color_t  bg;
+} glyph_t;
+
+// Drawing target state that lcd_setCanvas() switches.
+typedef struct {
+	coord_t  width;
+	coord_t  height;
+	coord_t  stride;
+	bool     use_frame_buffer;
+	bool     use_band;
+	bool     frame_swap;
+	color_t *frame_buffer;
+	uint8_t *frame_index;
+	damage_t damage_mode;
+	rect_t   view;
+	coord_t  orgx;
+	coord_t  orgy;
+} target_t;
+
+#define TILE_COLS  ((LCD_W+TILE_SIZE-1)/TILE_SIZE)
+#define TILE_ROWS  ((LCD_H+TILE_SIZE-1)/TILE_SIZE)
+#define TILE_WORDS ((TILE_COLS+31)/32)
+
 typedef struct {
 	coord_t     width;
 	coord_t     height;
+	coord_t     stride;       // frame buffer pixels from one row to the next
 	coord_t     offsetx;
 	coord_t     offsety;
 	direction_t font_direction;
@@ -57,7 +125,53 @@ typedef struct {
 	int8_t      bl;
 	spi_device_handle_t SPIHandle;
 	bool        use_frame_buffer;
-	color_t   *frame_buffer;
+	bool        frame_swap;   // frame buffer is in panel byte order
+	color_t    *frame_buffer;
+	uint8_t    *frame_index;  // indexed frame buffer, one byte per pixel
+	uint16_t    pal_cnt;      // palette entries in use
+	uint8_t     pal_last;     // entry found by the last lookup
+	color_t     pal_key[PAL_MAX]; // color that selects each entry
+	color_t     pal_out[PAL_MAX]; // displayed color, panel byte order
+	color_t    *front_buf[2]; // ping-pong strips for lcd_writeFrameAsync(), DMA capable
+	bool        front_fail;   // front strips could not be allocated
+	uint16_t    trans_head;   // next free slot in trans[]
+	uint16_t    trans_pend;   // queued transactions not yet reclaimed
+	bool        buf_busy;     // queued transactions read from buffer[]
+	uint16_t    win[4];       // last column and page addresses sent
+	damage_t    damage_mode;
+	bool        damage_full;
+	uint8_t     damage_cnt;
+	rect_t      damage[DAMAGE_MAX]; // changed frame buffer regions
+	uint32_t    tile_map[TILE_ROWS][TILE_WORDS]; // changed tiles
+	uint16_t    region_iter;
+	frame_stats_t stats;
+	bool        use_band;
+	bool        band_dirty;   // display list changed since the last write
+	color_t     band_back;    // strip background, panel byte order
+	uint16_t   *band_list;    // display list of draw operations
+	size_t      band_size;    // display list capacity in words
+	size_t      band_len;     // display list words used
+	uint32_t    band_drop;    // draws dropped because the list was full
+	color_t    *band_buf[2];  // ping-pong strips, panel byte order
+	uint8_t     span_hold;    // nesting depth of functions combining writes
+	uint8_t     span_cnt;
+	span_t      span[SPAN_MAX]; // pending writes, oldest first
+	glyph_t     glyph[GLYPH_SLOTS]; // expanded characters for opaque text
+	rect_t      fill_box;     // frame buffer area written by a scanline fill
+	coord_t     scroll_top;   // first row of the hardware scroll area
+	coord_t     scroll_height; // rows in the hardware scroll area
+	uint32_t    circle_built; // bit r is set when the table for radius r is cached
+	uint16_t    circle_hw[CIRCLE_CACHE_LEN]; // circle half-widths, radius r at r*(r+1)/2
+	color_t    *line_buf[2];  // ping-pong rows for lcd_drawLines(), DMA capable
+	bool        line_fail[2]; // line buffer could not be allocated, not retried
+	rect_t      view;         // clip rectangle on the target
+	coord_t     orgx;         // target position of drawing coordinate (0, 0)
+	coord_t     orgy;
+	rect_t      clip;         // view in drawing coordinates
+	coord_t     winx;         // panel position of drawing coordinate (0, 0)
+	coord_t     winy;
+	const canvas_t *canvas;   // drawing target, NULL for the screen
+	target_t    screen;       // screen state while a canvas is the target
 } TFT_t;
 
 typedef enum {
@@ -84,6 +198,21 @@ static int32_t clock_freq_hz = LCD_SPI_FREQ;
 #define BUF_LEN 512
 static uint16_t buffer[BUF_LEN];
 
+// Queued (DMA) transactions. A full frame is the 5 window setup
+// transactions plus (LCD_H+DMA_LINES-1)/DMA_LINES data transactions.
+#define DMA_LINES 16
+#define XFER_MAX (LCD_W*DMA_LINES*sizeof(color_t))
+#define LINE_GROUP 4 // rows per transaction from lcd_drawLines(), <= DMA_LINES
+#define LINE_PART 32 // pixels per line call when lcd_drawLines() has no buffer
+#define TRANS_MAX 24
+static spi_transaction_t trans[TRANS_MAX];
+
+// Drive D/C from the transaction user field before each transfer.
+static void IRAM_ATTR spi_master_pre_cb(spi_transaction_t *t)
+{
+	gpio_set_level(LCD_DC, (int)(intptr_t)t->user);
+}
+
 static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, int16_t GPIO_CS, int16_t GPIO_DC, int16_t GPIO_RST, int16_t GPIO_BL)
 {
 	esp_err_t ret;
@@ -122,7 +251,7 @@ static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, in
 		.sclk_io_num = GPIO_SCLK,
 		.quadwp_io_num = -1,
 		.quadhd_io_num = -1,
-		.max_transfer_sz = 0,
+		.max_transfer_sz = XFER_MAX,
 		.flags = 0
 	};
 
@@ -133,9 +262,10 @@ static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, in
 	spi_device_interface_config_t devcfg;
 	memset(&devcfg, 0, sizeof(devcfg));
 	devcfg.clock_speed_hz = clock_freq_hz;
-	devcfg.queue_size = 7;
+	devcfg.queue_size = TRANS_MAX;
 	devcfg.mode = 3;
 	devcfg.flags = SPI_DEVICE_NO_DUMMY;
+	devcfg.pre_cb = spi_master_pre_cb;
 
 	if ( GPIO_CS >= 0 ) {
 		devcfg.spics_io_num = GPIO_CS;
@@ -151,23 +281,88 @@ static void spi_master_init(TFT_t *dev, int16_t GPIO_MOSI, int16_t GPIO_SCLK, in
 	dev->dc = GPIO_DC;
 	dev->bl = GPIO_BL;
 	dev->SPIHandle = handle;
+	dev->trans_head = 0;
+	dev->trans_pend = 0;
+	dev->buf_busy = false;
+	memset(dev->win, 0xFF, sizeof(dev->win)); // none sent yet
+}
+
+// Wait for queued transactions to finish, oldest first, until no more
+// than keep are still pending.
+static void spi_master_queue_reclaim(TFT_t *dev, uint16_t keep)
+{
+	spi_transaction_t *rtrans;
+	esp_err_t ret;
+
+	while (dev->trans_pend > keep) {
+		ret = spi_device_get_trans_result( dev->SPIHandle, &rtrans, portMAX_DELAY );
+		assert(ret==ESP_OK);
+		dev->trans_pend--;
+	}
+	if (dev->trans_pend == 0) dev->buf_busy = false;
+}
+
+// Wait for all queued transactions to finish and reclaim them.
+static void spi_master_queue_wait(TFT_t *dev)
+{
+	spi_master_queue_reclaim(dev, 0);
+}
+
+// Queue a transaction without waiting for it to finish. Data of four bytes
+// or less is copied into the transaction, otherwise the buffer must stay
+// valid until the transaction is reclaimed by spi_master_queue_wait().
+static bool spi_master_queue_bytes(TFT_t *dev, const uint8_t* Data, size_t DataLength, spi_mode_t mode)
+{
+	spi_transaction_t *SPITransaction;
+	spi_transaction_t *rtrans;
+	esp_err_t ret;
+
+	if ( DataLength > 0 ) {
+		if ( dev->trans_pend == TRANS_MAX ) { // reclaim the oldest
+			ret = spi_device_get_trans_result( dev->SPIHandle, &rtrans, portMAX_DELAY );
+			assert(ret==ESP_OK);
+			dev->trans_pend--;
+		}
+		SPITransaction = &trans[dev->trans_head];
+		if (++dev->trans_head == TRANS_MAX) dev->trans_head = 0;
+		memset( SPITransaction, 0, sizeof( spi_transaction_t ) );
+		SPITransaction->length = DataLength * 8;
+		SPITransaction->user = (void *)(intptr_t)mode;
+		if ( DataLength <= sizeof(SPITransaction->tx_data) ) {
+			SPITransaction->flags = SPI_TRANS_USE_TXDATA;
+			memcpy( SPITransaction->tx_data, Data, DataLength );
+		} else {
+			SPITransaction->tx_buffer = Data;
+		}
+		ret = spi_device_queue_trans( dev->SPIHandle, SPITransaction, portMAX_DELAY );
+		assert(ret==ESP_OK);
+		dev->trans_pend++;
+		dev->stats.trans++;
+		dev->stats.bytes += DataLength;
+	}
+
+	return true;
 }
 
-static bool spi_master_write_bytes(spi_device_handle_t SPIHandle, const uint8_t* Data, size_t DataLength)
+static bool spi_master_write_bytes(TFT_t *dev, const uint8_t* Data, size_t DataLength, spi_mode_t mode)
 {
 	spi_transaction_t SPITransaction;
 	esp_err_t ret;
 
 	if ( DataLength > 0 ) {
+		if ( dev->trans_pend ) spi_master_queue_wait(dev);
 		memset( &SPITransaction, 0, sizeof( spi_transaction_t ) );
 		SPITransaction.length = DataLength * 8;
 		SPITransaction.tx_buffer = Data;
+		SPITransaction.user = (void *)(intptr_t)mode;
 #if 0
-		ret = spi_device_transmit( SPIHandle, &SPITransaction );
+		ret = spi_device_transmit( dev->SPIHandle, &SPITransaction );
 #else
-		ret = spi_device_polling_transmit( SPIHandle, &SPITransaction );
+		ret = spi_device_polling_transmit( dev->SPIHandle, &SPITransaction );
 #endif
 		assert(ret==ESP_OK);
+		dev->stats.trans++;
+		dev->stats.bytes += DataLength;
 	}
 
 	return true;
@@ -177,16 +372,14 @@ static bool spi_master_write_command(TFT_t *dev, uint8_t cmd)
 {
 	static uint8_t Byte = 0;
 	Byte = cmd;
-	gpio_set_level( dev->dc, SPI_Command_Mode );
-	return spi_master_write_bytes( dev->SPIHandle, &Byte, 1 );
+	return spi_master_write_bytes( dev, &Byte, 1, SPI_Command_Mode );
 }
 
 static bool spi_master_write_data_byte(TFT_t *dev, uint8_t data)
 {
 	static uint8_t Byte = 0;
 	Byte = data;
-	gpio_set_level( dev->dc, SPI_Data_Mode );
-	return spi_master_write_bytes( dev->SPIHandle, &Byte, 1 );
+	return spi_master_write_bytes( dev, &Byte, 1, SPI_Data_Mode );
 }
 
 #if 0
@@ -195,11 +388,11 @@ static bool spi_master_write_data_word(TFT_t *dev, uint16_t data)
 	static uint8_t Byte[2];
 	Byte[0] = (data >> 8) & 0xFF;
 	Byte[1] = data & 0xFF;
-	gpio_set_level( dev->dc, SPI_Data_Mode );
-	return spi_master_write_bytes( dev->SPIHandle, Byte, 2);
+	return spi_master_write_bytes( dev, Byte, 2, SPI_Data_Mode );
 }
 #endif
 
+#if !DIRECT_QUEUE
 static bool spi_master_write_addr(TFT_t *dev, uint16_t addr1, uint16_t addr2)
 {
 	static uint8_t Byte[4];
@@ -207,8 +400,28 @@ static bool spi_master_write_addr(TFT_t *dev, uint16_t addr1, uint16_t addr2)
 	Byte[1] = addr1 & 0xFF;
 	Byte[2] = (addr2 >> 8) & 0xFF;
 	Byte[3] = addr2 & 0xFF;
-	gpio_set_level( dev->dc, SPI_Data_Mode );
-	return spi_master_write_bytes( dev->SPIHandle, Byte, 4);
+	return spi_master_write_bytes( dev, Byte, 4, SPI_Data_Mode );
+}
+#endif
+
+// Wait until no queued transaction reads from buffer[], so it can be
+// filled again.
+inline static void spi_master_buffer_wait(TFT_t *dev)
+{
+	if (dev->buf_busy) spi_master_queue_wait(dev);
+}
+
+// Send color data from buffer[]. With DIRECT_QUEUE, the data is queued
+// behind the window set up by spi_master_write_window() and the caller
+// returns without waiting for it.
+inline static bool spi_master_write_buffer(TFT_t *dev, size_t len)
+{
+#if DIRECT_QUEUE
+	if (len > sizeof(((spi_transaction_t *)0)->tx_data)) dev->buf_busy = true;
+	return spi_master_queue_bytes(dev, (uint8_t *)buffer, len, SPI_Data_Mode);
+#else
+	return spi_master_write_bytes(dev, (uint8_t *)buffer, len, SPI_Data_Mode);
+#endif
 }
 
 // size is number of color elements, not bytes.
@@ -216,11 +429,11 @@ inline static bool spi_master_write_color(TFT_t *dev, color_t color, size_t size
 {
 	uint16_t temp = SWAP16(color);
 	size_t n = (size < BUF_LEN) ? size : BUF_LEN;
-	for (size_t i = 0; i < n; i++) buffer[i] = temp;
-	gpio_set_level(dev->dc, SPI_Data_Mode);
+	spi_master_buffer_wait(dev);
+	kern_fill16(buffer, temp, n);
 	while (size) {
 		n = (size < BUF_LEN) ? size : BUF_LEN;
-		spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
+		spi_master_write_buffer(dev, n*sizeof(uint16_t));
 		size -= n;
 	}
 	return true;
@@ -229,11 +442,151 @@ inline static bool spi_master_write_color(TFT_t *dev, color_t color, size_t size
 // size is number of color elements, not bytes.
 inline static bool spi_master_write_colors(TFT_t *dev, const color_t *colors, size_t size)
 {
-	gpio_set_level(dev->dc, SPI_Data_Mode);
 	while (size) {
 		size_t n = (size < BUF_LEN) ? size : BUF_LEN;
-		for (size_t i = 0; i < n; i++) buffer[i] = SWAP16(colors[i]);
-		spi_master_write_bytes(dev->SPIHandle, (uint8_t *)buffer, n*sizeof(uint16_t));
+		spi_master_buffer_wait(dev);
+		kern_copy16_swap(buffer, colors, n);
+		spi_master_write_buffer(dev, n*sizeof(uint16_t));
+		colors += n;
+		size -= n;
+	}
+	return true;
+}
+
+// Write a w x h block of colors. Rows are stride elements apart.
+// If swapped, colors are already in panel byte order.
+inline static bool spi_master_write_rect(TFT_t *dev, const color_t *colors, size_t stride, size_t w, size_t h, bool swapped)
+{
+	size_t n = 0;
+	spi_master_buffer_wait(dev);
+	for (; h; h--, colors += stride) {
+		for (size_t i = 0; i < w; ) {
+			size_t m = (w-i < BUF_LEN-n) ? w-i : BUF_LEN-n;
+			if (swapped) kern_copy16(buffer+n, colors+i, m);
+			else kern_copy16_swap(buffer+n, colors+i, m);
+			n += m; i += m;
+			if (n == BUF_LEN) {
+				spi_master_write_bytes(dev, (uint8_t *)buffer, n*sizeof(uint16_t), SPI_Data_Mode);
+				n = 0;
+			}
+		}
+	}
+	if (n) spi_master_write_bytes(dev, (uint8_t *)buffer, n*sizeof(uint16_t), SPI_Data_Mode);
+	return true;
+}
+
+// Write a w x h block of palette indexes expanded through lut, which
+// holds colors in panel byte order. Rows are stride elements apart.
+inline static bool spi_master_write_index(TFT_t *dev, const uint8_t *index, size_t stride, size_t w, size_t h, const color_t *lut)
+{
+	size_t n = 0;
+	spi_master_buffer_wait(dev);
+	for (; h; h--, index += stride) {
+		for (size_t i = 0; i < w; ) {
+			size_t m = (w-i < BUF_LEN-n) ? w-i : BUF_LEN-n;
+			for (size_t k = 0; k < m; k++) buffer[n+k] = lut[index[i+k]];
+			n += m; i += m;
+			if (n == BUF_LEN) {
+				spi_master_write_bytes(dev, (uint8_t *)buffer, n*sizeof(uint16_t), SPI_Data_Mode);
+				n = 0;
+			}
+		}
+	}
+	if (n) spi_master_write_bytes(dev, (uint8_t *)buffer, n*sizeof(uint16_t), SPI_Data_Mode);
+	return true;
+}
+
+// Expand n bits of a 1-bit bitmap row, starting at bit i, into colors.
+inline static void bitmap_expand(color_t *dst, const uint8_t *row, size_t i, size_t n, color_t fg, color_t bg)
+{
+	const uint8_t *p = row + (i >> 3);
+	uint8_t b = *p++ << (i & 7);
+	for (size_t k = 0, r = 8 - (i & 7); k < n; k++, b <<= 1) {
+		if (r-- == 0) {b = *p++; r = 7;}
+		dst[k] = (b & 0x80) ? fg : bg;
+	}
+}
+
+// Write a w x h block of a 1-bit bitmap starting at bit i0 of each row,
+// with fg for set bits and bg for clear bits. Rows are stride bytes apart.
+inline static bool spi_master_write_bits(TFT_t *dev, const uint8_t *bits, size_t stride, size_t i0, size_t w, size_t h, color_t fg, color_t bg)
+{
+	size_t n = 0;
+	fg = SWAP16(fg);
+	bg = SWAP16(bg);
+	spi_master_buffer_wait(dev);
+	for (; h; h--, bits += stride) {
+		for (size_t i = 0; i < w; ) {
+			size_t m = (w-i < BUF_LEN-n) ? w-i : BUF_LEN-n;
+			bitmap_expand(buffer+n, bits, i0+i, m, fg, bg);
+			n += m; i += m;
+			if (n == BUF_LEN) {
+				spi_master_write_buffer(dev, n*sizeof(uint16_t));
+				spi_master_buffer_wait(dev);
+				n = 0;
+			}
+		}
+	}
+	if (n) spi_master_write_buffer(dev, n*sizeof(uint16_t));
+	return true;
+}
+
+// Queue the column, page and memory write commands for a window. Memory
+// Write restarts at the window origin, so column or page addresses that
+// are unchanged from the last window are not sent again.
+static bool spi_master_queue_window(TFT_t *dev, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+	uint8_t Byte[4];
+	if (x1 != dev->win[0] || x2 != dev->win[1]) {
+		Byte[0] = 0x2A; // Column(x) Address Set
+		spi_master_queue_bytes(dev, Byte, 1, SPI_Command_Mode);
+		Byte[0] = (x1 >> 8) & 0xFF;
+		Byte[1] = x1 & 0xFF;
+		Byte[2] = (x2 >> 8) & 0xFF;
+		Byte[3] = x2 & 0xFF;
+		spi_master_queue_bytes(dev, Byte, 4, SPI_Data_Mode);
+		dev->win[0] = x1;
+		dev->win[1] = x2;
+	}
+	if (y1 != dev->win[2] || y2 != dev->win[3]) {
+		Byte[0] = 0x2B; // Page(y) Address Set
+		spi_master_queue_bytes(dev, Byte, 1, SPI_Command_Mode);
+		Byte[0] = (y1 >> 8) & 0xFF;
+		Byte[1] = y1 & 0xFF;
+		Byte[2] = (y2 >> 8) & 0xFF;
+		Byte[3] = y2 & 0xFF;
+		spi_master_queue_bytes(dev, Byte, 4, SPI_Data_Mode);
+		dev->win[2] = y1;
+		dev->win[3] = y2;
+	}
+	Byte[0] = 0x2C; // Memory Write
+	return spi_master_queue_bytes(dev, Byte, 1, SPI_Command_Mode);
+}
+
+// Set the window for the following color data. With DIRECT_QUEUE, the
+// five transactions are queued as one batch with D/C driven by pre_cb.
+static bool spi_master_write_window(TFT_t *dev, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2)
+{
+#if DIRECT_QUEUE
+	return spi_master_queue_window(dev, x1, y1, x2, y2);
+#else
+	spi_master_write_command(dev, 0x2A); // Column(x) Address Set
+	spi_master_write_addr(dev, x1, x2);
+	spi_master_write_command(dev, 0x2B); // Page(y) Address Set
+	spi_master_write_addr(dev, y1, y2);
+	dev->win[0] = x1; dev->win[1] = x2;
+	dev->win[2] = y1; dev->win[3] = y2;
+	return spi_master_write_command(dev, 0x2C); // Memory Write
+#endif
+}
+
+// size is number of color elements, not bytes. Colors must already be
+// in panel byte order and stay valid until the transactions complete.
+static bool spi_master_queue_colors(TFT_t *dev, const color_t *colors, size_t size)
+{
+	while (size) {
+		size_t n = (size < XFER_MAX/sizeof(color_t)) ? size : XFER_MAX/sizeof(color_t);
+		spi_master_queue_bytes(dev, (const uint8_t *)colors, n*sizeof(color_t), SPI_Data_Mode);
 		colors += n;
 		size -= n;
 	}
@@ -241,6 +594,1017 @@ inline static bool spi_master_write_colors(TFT_t *dev, const color_t *colors, si
 }
 
 
+//----------------------------------------------------------------------------//
+// Direct-mode write-combining
+//----------------------------------------------------------------------------//
+
+// Pixel-heavy functions hold writes while they run. Each write is merged
+// into a pending span of the same color when it extends that span along
+// a row or column, otherwise it takes a new span. Pending spans never
+// overlap, so they can be written in any order. They are written when
+// all spans are in use (oldest first), when a write overlaps one of them,
+// when the outermost holding function returns, or by lcd_flush().
+
+#define RECT_OVERLAP(a,b) \
+	((a).x0 <= (b).x1 && (b).x0 <= (a).x1 && (a).y0 <= (b).y1 && (b).y0 <= (a).y1)
+
+static void span_write(TFT_t *dev, const span_t *s)
+{
+	spi_master_write_window(dev,
+		s->r.x0+dev->winx, s->r.y0+dev->winy,
+		s->r.x1+dev->winx, s->r.y1+dev->winy);
+	spi_master_write_color(dev, s->color,
+		(size_t)(s->r.x1-s->r.x0+1)*(s->r.y1-s->r.y0+1));
+}
+
+// Write all pending spans.
+static void span_flush(TFT_t *dev)
+{
+	for (uint8_t i = 0; i < dev->span_cnt; i++) span_write(dev, &dev->span[i]);
+	dev->span_cnt = 0;
+}
+
+static void span_hold(TFT_t *dev)
+{
+	dev->span_hold++;
+}
+
+static void span_release(TFT_t *dev)
+{
+	if (--dev->span_hold == 0) span_flush(dev);
+}
+
+// Add a rectangle fill to the pending spans. Coordinates must already be
+// clipped to the screen.
+static void span_add(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	rect_t n = {x0, y0, x1, y1};
+
+	for (uint8_t i = 0; i < dev->span_cnt; i++) {
+		span_t *s = &dev->span[i];
+		if (!RECT_OVERLAP(s->r, n)) continue;
+		if (s->color == color && x0 >= s->r.x0 && x1 <= s->r.x1 &&
+			y0 >= s->r.y0 && y1 <= s->r.y1) return; // no change
+		span_flush(dev); // keep pending spans disjoint
+		break;
+	}
+	for (uint8_t i = 0; i < dev->span_cnt; i++) {
+		span_t *s = &dev->span[i];
+		if (s->color != color) continue;
+		if (s->r.y0 == y0 && s->r.y1 == y1) { // same rows
+			if (x1+1 == s->r.x0) {s->r.x0 = x0; return;}
+			if (s->r.x1+1 == x0) {s->r.x1 = x1; return;}
+		}
+		if (s->r.x0 == x0 && s->r.x1 == x1) { // same columns
+			if (y1+1 == s->r.y0) {s->r.y0 = y0; return;}
+			if (s->r.y1+1 == y0) {s->r.y1 = y1; return;}
+		}
+	}
+	if (dev->span_cnt == SPAN_MAX) { // write the oldest
+		span_write(dev, &dev->span[0]);
+		memmove(dev->span, dev->span+1, (SPAN_MAX-1)*sizeof(span_t));
+		dev->span_cnt--;
+	}
+	dev->span[dev->span_cnt].r = n;
+	dev->span[dev->span_cnt].color = color;
+	dev->span_cnt++;
+}
+
+//----------------------------------------------------------------------------//
+// Frame damage tracking
+//----------------------------------------------------------------------------//
+
+#define RECT_AREA(r) ((int32_t)((r).x1-(r).x0+1)*((r).y1-(r).y0+1))
+#define TILE_GET(ty,tx) ((dev->tile_map[ty][(tx)>>5] >> ((tx)&31)) & 1)
+
+// Record a changed region of the frame buffer. Coordinates must already be
+// clipped to the frame. In DAMAGE_RECT mode, the region is merged into an
+// existing one when the overdraw is small, otherwise it is appended to the
+// list. In DAMAGE_TILE mode, the covered tiles are marked.
+static void frame_damage(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1)
+{
+	if (dev->damage_mode == DAMAGE_TILE) {
+		coord_t tx0 = x0/TILE_SIZE, tx1 = x1/TILE_SIZE;
+		for (coord_t ty = y0/TILE_SIZE; ty <= y1/TILE_SIZE; ty++) {
+			for (coord_t tx = tx0; tx <= tx1; tx++) {
+				dev->tile_map[ty][tx>>5] |= 1UL << (tx&31);
+			}
+		}
+		return;
+	}
+	if (dev->damage_mode != DAMAGE_RECT) return;
+
+	rect_t n = {x0, y0, x1, y1};
+	rect_t u;
+	int32_t best = INT32_MAX;
+	uint8_t bi = 0;
+
+	for (uint8_t i = dev->damage_cnt; i-- > 0; ) {
+		rect_t *r = &dev->damage[i];
+		if (x0 >= r->x0 && x1 <= r->x1 && y0 >= r->y0 && y1 <= r->y1) return;
+		u.x0 = (x0 < r->x0) ? x0 : r->x0;
+		u.y0 = (y0 < r->y0) ? y0 : r->y0;
+		u.x1 = (x1 > r->x1) ? x1 : r->x1;
+		u.y1 = (y1 > r->y1) ? y1 : r->y1;
+		int32_t grow = RECT_AREA(u) - RECT_AREA(*r) - RECT_AREA(n);
+		if (grow <= DAMAGE_SLACK) {*r = u; return;}
+		if (grow < best) {best = grow; bi = i;}
+	}
+	if (dev->damage_cnt < DAMAGE_MAX) {
+		dev->damage[dev->damage_cnt++] = n;
+	} else { // list full, grow the cheapest region
+		rect_t *r = &dev->damage[bi];
+		if (x0 < r->x0) r->x0 = x0;
+		if (y0 < r->y0) r->y0 = y0;
+		if (x1 > r->x1) r->x1 = x1;
+		if (y1 > r->y1) r->y1 = y1;
+	}
+}
+
+// Mark the whole frame as changed.
+static void frame_damage_all(TFT_t *dev)
+{
+	if (dev->canvas != NULL) return;
+	dev->damage_full = true;
+}
+
+// Forget all changes, called after a frame write.
+static void frame_damage_clear(TFT_t *dev)
+{
+	dev->damage_full = false;
+	dev->damage_cnt = 0;
+	memset(dev->tile_map, 0, sizeof(dev->tile_map));
+}
+
+// Start iterating over the regions to send for a frame write. When the
+// changed area is large, a single full-frame region is used since one
+// long transfer is faster than many windows.
+static void frame_region_start(TFT_t *dev)
+{
+	int32_t area = 0;
+
+	dev->region_iter = 0;
+	if (dev->damage_mode == DAMAGE_NONE) dev->damage_full = true;
+	if (dev->damage_full) return;
+	if (dev->damage_mode == DAMAGE_TILE) {
+		for (coord_t ty = 0; ty < TILE_ROWS; ty++)
+			for (coord_t w = 0; w < TILE_WORDS; w++)
+				area += __builtin_popcount(dev->tile_map[ty][w]);
+		area *= TILE_SIZE*TILE_SIZE;
+	} else {
+		for (uint8_t i = 0; i < dev->damage_cnt; i++) area += RECT_AREA(dev->damage[i]);
+	}
+	if (area*100 >= (int32_t)dev->width*dev->height*DAMAGE_FULL) dev->damage_full = true;
+}
+
+// Get the next region to send. Returns false when there are no more.
+// In DAMAGE_TILE mode, horizontally adjacent changed tiles are combined
+// into one region.
+static bool frame_region_next(TFT_t *dev, rect_t *r)
+{
+	if (dev->damage_full) {
+		if (dev->region_iter++) return false;
+		r->x0 = 0;
+		r->y0 = 0;
+		r->x1 = dev->width-1;
+		r->y1 = dev->height-1;
+		return true;
+	}
+	if (dev->damage_mode == DAMAGE_RECT) {
+		if (dev->region_iter >= dev->damage_cnt) return false;
+		*r = dev->damage[dev->region_iter++];
+		return true;
+	}
+	while (dev->region_iter < TILE_ROWS*TILE_COLS) {
+		coord_t ty  = dev->region_iter / TILE_COLS;
+		coord_t tx0 = dev->region_iter % TILE_COLS;
+		if (!TILE_GET(ty, tx0)) {dev->region_iter++; continue;}
+		coord_t tx1 = tx0;
+		while (tx1+1 < TILE_COLS && TILE_GET(ty, tx1+1)) tx1++;
+		dev->region_iter = ty*TILE_COLS + tx1 + 1;
+		r->x0 = tx0*TILE_SIZE;
+		r->y0 = ty*TILE_SIZE;
+		r->x1 = (tx1+1)*TILE_SIZE-1;
+		r->y1 = (ty+1)*TILE_SIZE-1;
+		if (r->x1 >= dev->width) r->x1 = dev->width-1;
+		if (r->y1 >= dev->height) r->y1 = dev->height-1;
+		return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------//
+// Frame buffer
+//----------------------------------------------------------------------------//
+
+#define RGB_DIFF(a,b,s,m) ((int32_t)(((a)>>(s))&(m)) - (int32_t)(((b)>>(s))&(m)))
+
+// Get the palette entry for a color. A new color takes the next free
+// entry. When the palette is full, the nearest color is used.
+static uint8_t palette_index(TFT_t *dev, color_t color)
+{
+	if (dev->pal_cnt && dev->pal_key[dev->pal_last] == color) return dev->pal_last;
+	for (uint16_t i = 0; i < dev->pal_cnt; i++) {
+		if (dev->pal_key[i] == color) return dev->pal_last = i;
+	}
+	if (dev->pal_cnt < PAL_MAX) {
+		dev->pal_key[dev->pal_cnt] = color;
+		dev->pal_out[dev->pal_cnt] = SWAP16(color);
+		return dev->pal_last = dev->pal_cnt++;
+	}
+	int32_t best = INT32_MAX;
+	for (uint16_t i = 0; i < PAL_MAX; i++) {
+		int32_t r = RGB_DIFF(color, dev->pal_key[i], 11, 0x1F) << 1;
+		int32_t g = RGB_DIFF(color, dev->pal_key[i],  5, 0x3F);
+		int32_t b = RGB_DIFF(color, dev->pal_key[i],  0, 0x1F) << 1;
+		int32_t d = r*r + g*g + b*b;
+		if (d < best) {best = d; dev->pal_last = i;}
+	}
+	return dev->pal_last;
+}
+
+// Fill a region of the frame buffer. Coordinates are drawing coordinates
+// and must already be clipped.
+static void frame_fill(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	size_t w = dev->stride;
+	x0 += dev->orgx; x1 += dev->orgx;
+	y0 += dev->orgy; y1 += dev->orgy;
+	if (dev->frame_index != NULL) {
+		uint8_t ci = palette_index(dev, color);
+		for (coord_t j = y0; j <= y1; j++) {
+			memset(dev->frame_index + j*w + x0, ci, x1-x0+1);
+		}
+	} else {
+		kern_fill_rect16(dev->frame_buffer + y0*w + x0, w,
+			x1-x0+1, y1-y0+1, FB_COLOR(color));
+	}
+	frame_damage(dev, x0, y0, x1, y1);
+}
+
+// Copy a row of pixels into the frame buffer. Coordinates are drawing
+// coordinates and must already be clipped.
+static void frame_copy(TFT_t *dev, coord_t x0, coord_t y, coord_t w, const color_t *colors)
+{
+	x0 += dev->orgx;
+	y += dev->orgy;
+	size_t fbidx = (size_t)y*dev->stride + x0;
+	if (dev->frame_index != NULL) {
+		for (coord_t i = 0; i < w; i++) {
+			dev->frame_index[fbidx+i] = palette_index(dev, colors[i]);
+		}
+	} else if (dev->frame_swap) {
+		kern_copy16_swap(dev->frame_buffer+fbidx, colors, w);
+	} else {
+		kern_copy16(dev->frame_buffer+fbidx, colors, w);
+	}
+	frame_damage(dev, x0, y, x0+w-1, y);
+}
+
+// Copy a block of pixels into the frame buffer, one row at a time. Rows of
+// src are stride elements apart. Coordinates are drawing coordinates and
+// must already be clipped.
+static void frame_image(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, const color_t *src, coord_t stride)
+{
+	x0 += dev->orgx; x1 += dev->orgx;
+	y0 += dev->orgy; y1 += dev->orgy;
+	size_t fbidx = (size_t)y0*dev->stride + x0;
+	coord_t w = x1-x0+1;
+	for (coord_t y = y0; y <= y1; y++, src += stride, fbidx += dev->stride) {
+		if (dev->frame_index != NULL) {
+			for (coord_t i = 0; i < w; i++) {
+				dev->frame_index[fbidx+i] = palette_index(dev, src[i]);
+			}
+		} else if (dev->frame_swap) {
+			kern_copy16_swap(dev->frame_buffer+fbidx, src, w);
+		} else {
+			kern_copy16(dev->frame_buffer+fbidx, src, w);
+		}
+	}
+	frame_damage(dev, x0, y0, x1, y1);
+}
+
+//----------------------------------------------------------------------------//
+// Band rendering
+//----------------------------------------------------------------------------//
+
+// In band mode, draws are recorded in a display list instead of a frame
+// buffer. A frame write rasterizes the list into strips of BAND_LINES
+// rows, one strip while the other is sent by DMA. Operations are stored
+// clipped and moved to the drawing origin, with colors in panel byte order:
+//   BAND_FILL:  op, x0, y0, x1, y1, color
+//   BAND_COPY:  op, x0, y, w, colors[w]
+//   BAND_IMAGE: op, x0, y0, x1, y1, stride, pointer to first pixel
+// The list is kept between frames and reset by lcd_fillScreen().
+
+#define BAND_LINES DMA_LINES // one transaction per strip
+#define BAND_PTR_WORDS (sizeof(const color_t *)/sizeof(uint16_t))
+
+enum {
+	BAND_FILL,
+	BAND_COPY,
+	BAND_IMAGE,
+};
+
+// Reserve words in the display list. Returns NULL if the list is full.
+static uint16_t *band_alloc(TFT_t *dev, size_t words)
+{
+	if (dev->band_len + words > dev->band_size) {
+		dev->band_drop++;
+		return NULL;
+	}
+	uint16_t *op = dev->band_list + dev->band_len;
+	dev->band_len += words;
+	dev->band_dirty = true;
+	return op;
+}
+
+// Clear the display list, every strip starts filled with color.
+static void band_clear(TFT_t *dev, color_t color)
+{
+	dev->band_len = 0;
+	dev->band_back = SWAP16(color);
+	dev->band_dirty = true;
+}
+
+// Record a rectangle fill. Coordinates are drawing coordinates and must
+// already be clipped.
+static void band_fill(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
+{
+	x0 += dev->orgx; x1 += dev->orgx;
+	y0 += dev->orgy; y1 += dev->orgy;
+	if (x0 == 0 && y0 == 0 && x1 == dev->width-1 && y1 == dev->height-1) {
+		band_clear(dev, color); // covers everything recorded so far
+		return;
+	}
+	uint16_t *op = band_alloc(dev, 6);
+	if (op == NULL) return;
+	op[0] = BAND_FILL;
+	op[1] = x0;
+	op[2] = y0;
+	op[3] = x1;
+	op[4] = y1;
+	op[5] = SWAP16(color);
+}
+
+// Record a row of pixels. The colors are copied into the list.
+static void band_copy(TFT_t *dev, coord_t x0, coord_t y, coord_t w, const color_t *colors)
+{
+	uint16_t *op = band_alloc(dev, 4+w);
+	if (op == NULL) return;
+	op[0] = BAND_COPY;
+	op[1] = x0 + dev->orgx;
+	op[2] = y + dev->orgy;
+	op[3] = w;
+	kern_copy16_swap(op+4, colors, w);
+}
+
+// Record an image by reference. Rows of the source are stride elements
+// apart and must stay valid until the frame is written.
+static void band_image(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, const color_t *src, coord_t stride)
+{
+	uint16_t *op = band_alloc(dev, 6+BAND_PTR_WORDS);
+	if (op == NULL) return;
+	op[0] = BAND_IMAGE;
+	op[1] = x0 + dev->orgx;
+	op[2] = y0 + dev->orgy;
+	op[3] = x1 + dev->orgx;
+	op[4] = y1 + dev->orgy;
+	op[5] = stride;
+	memcpy(op+6, &src, sizeof(src));
+}
+
+// Rasterize the display list into a strip holding rows y0 to y1.
+static void band_raster(TFT_t *dev, color_t *strip, coord_t y0, coord_t y1)
+{
+	size_t w = dev->width;
+	kern_fill16(strip, dev->band_back, w*(y1-y0+1));
+
+	for (size_t i = 0; i < dev->band_len; ) {
+		const uint16_t *op = dev->band_list + i;
+		switch (op[0]) {
+		case BAND_FILL: {
+			i += 6;
+			coord_t t = (op[2] > y0) ? op[2] : y0;
+			coord_t b = (op[4] < y1) ? op[4] : y1;
+			if (t <= b) kern_fill_rect16(strip + (t-y0)*w + op[1], w,
+				op[3]-op[1]+1, b-t+1, op[5]);
+			break; }
+		case BAND_COPY:
+			i += 4+op[3];
+			if (op[2] < y0 || op[2] > y1) break;
+			kern_copy16(strip + (op[2]-y0)*w + op[1], op+4, op[3]);
+			break;
+		case BAND_IMAGE: {
+			i += 6+BAND_PTR_WORDS;
+			coord_t t = (op[2] > y0) ? op[2] : y0;
+			coord_t b = (op[4] < y1) ? op[4] : y1;
+			const color_t *src;
+			memcpy(&src, op+6, sizeof(src));
+			src += (t-op[2])*op[5];
+			for (coord_t y = t; y <= b; y++, src += op[5]) {
+				kern_copy16_swap(strip + (y-y0)*w + op[1], src, op[3]-op[1]+1);
+			}
+			break; }
+		}
+	}
+}
+
+// Rasterize and send the frame strip by strip. Each strip is one queued
+// transaction, so before reusing a strip buffer only the transaction for
+// the other strip may still be pending. If wait is false, return while
+// the last strips are still being sent.
+static void band_write(TFT_t *dev, bool wait)
+{
+	if (dev->band_drop) {
+		ESP_LOGW(TAG, "display list full, %lu draws dropped", (unsigned long)dev->band_drop);
+		dev->band_drop = 0;
+	}
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	if (!dev->band_dirty) return; // nothing changed on the panel
+
+	spi_master_queue_wait(dev); // previous frame done with the strips
+	spi_master_queue_window(dev,
+		dev->offsetx, dev->offsety,
+		dev->offsetx+dev->width-1, dev->offsety+dev->height-1);
+	for (coord_t y0 = 0, k = 0; y0 < dev->height; y0 += BAND_LINES, k++) {
+		coord_t y1 = (y0+BAND_LINES <= dev->height) ? y0+BAND_LINES-1 : dev->height-1;
+		color_t *strip = dev->band_buf[k&1];
+		if (k >= 2) spi_master_queue_reclaim(dev, 1);
+		band_raster(dev, strip, y0, y1);
+		spi_master_queue_colors(dev, strip, (size_t)dev->width*(y1-y0+1));
+	}
+	dev->stats.regions++;
+	dev->band_dirty = false;
+	if (wait) spi_master_queue_wait(dev);
+}
+
+//----------------------------------------------------------------------------//
+// Clipping
+//----------------------------------------------------------------------------//
+
+// Primitives take drawing coordinates, which are target coordinates less
+// the origin set by lcd_setOrigin(). They clip against dev->clip, the clip
+// rectangle in drawing coordinates, and the frame buffer, band and direct
+// mode writes add the origin back.
+
+// Corner of an empty clip rectangle, far enough out that every test
+// against it fails.
+#define CLIP_NONE (INT32_MAX/4)
+
+// Outcode bits of a point for Cohen-Sutherland line clipping.
+#define CLIP_LEFT   1
+#define CLIP_RIGHT  2
+#define CLIP_TOP    4
+#define CLIP_BOTTOM 8
+
+// Recompute the clip rectangle and direct mode offset after the view,
+// the origin or the target changes.
+static void clip_update(TFT_t *dev)
+{
+	rect_t *v = &dev->view;
+	if (v->x0 > v->x1 || v->y0 > v->y1) {
+		dev->clip = (rect_t){CLIP_NONE, CLIP_NONE, -CLIP_NONE, -CLIP_NONE};
+	} else {
+		dev->clip.x0 = v->x0 - dev->orgx;
+		dev->clip.y0 = v->y0 - dev->orgy;
+		dev->clip.x1 = v->x1 - dev->orgx;
+		dev->clip.y1 = v->y1 - dev->orgy;
+	}
+	dev->winx = dev->offsetx + dev->orgx;
+	dev->winy = dev->offsety + dev->orgy;
+}
+
+// Get the outcode of a point: where it lies outside the clip rectangle.
+static uint8_t clip_code(TFT_t *dev, coord_t x, coord_t y)
+{
+	uint8_t code = 0;
+	if (x < dev->clip.x0) code |= CLIP_LEFT;
+	else if (x > dev->clip.x1) code |= CLIP_RIGHT;
+	if (y < dev->clip.y0) code |= CLIP_TOP;
+	else if (y > dev->clip.y1) code |= CLIP_BOTTOM;
+	return code;
+}
+
+//----------------------------------------------------------------------------//
+// Scanline fills
+//----------------------------------------------------------------------------//
+
+// Filled shapes are computed a scanline at a time and written as clipped
+// horizontal spans between fill_begin() and fill_end(). Spans go straight
+// into the frame buffer, the band list or the write-combining queue. In
+// frame buffer mode the damage is recorded once for the whole shape,
+// except with DAMAGE_TILE where each span marks its own tiles.
+
+// Polygon edge stepped one scanline at a time without division. The x
+// crossing is x0 + dx*k/dy, truncated toward zero, after k steps. It is
+// kept as a whole part q and a fraction r/dy with 0 <= r < dy.
+typedef struct {
+	coord_t x0;
+	int32_t q, r;   // floor(dx*k/dy) and remainder
+	int32_t qs, rs; // whole part and remainder of one step
+	int32_t dy;
+	bool    neg;    // dx < 0, so truncation rounds up
+} edge_t;
+
+// Start an edge from (x0, y0) with slope dx/dy (dy > 0), k scanlines
+// below y0.
+static void edge_init(edge_t *e, coord_t x0, int32_t dx, int32_t dy, int32_t k)
+{
+	int32_t n = dx*k;
+	e->x0 = x0;
+	e->dy = dy;
+	e->neg = dx < 0;
+	e->q = n / dy;
+	e->r = n % dy;
+	if (e->r < 0) {e->q--; e->r += dy;}
+	e->qs = dx / dy;
+	e->rs = dx % dy;
+	if (e->rs < 0) {e->qs--; e->rs += dy;}
+}
+
+// X crossing at the current scanline.
+inline static coord_t edge_x(const edge_t *e)
+{
+	return e->x0 + e->q + (e->neg && e->r);
+}
+
+inline static void edge_step(edge_t *e)
+{
+	e->q += e->qs;
+	e->r += e->rs;
+	if (e->r >= e->dy) {e->q++; e->r -= e->dy;}
+}
+
+static void fill_begin(TFT_t *dev)
+{
+	dev->fill_box = (rect_t){dev->width, dev->height, -1, -1};
+	span_hold(dev);
+}
+
+// Fill from x0 to x1 on row y, clipped to the clip rectangle. y must be
+// inside it.
+static void fill_span(TFT_t *dev, coord_t x0, coord_t x1, coord_t y, color_t color)
+{
+	if (x0 > x1) swap(coord_t, x0, x1);
+	if (x0 < dev->clip.x0) x0 = dev->clip.x0; // clip
+	if (x1 > dev->clip.x1) x1 = dev->clip.x1;
+	if (x0 > x1) return;
+
+	if (dev->use_frame_buffer) {
+		x0 += dev->orgx; x1 += dev->orgx; // frame buffer position
+		y += dev->orgy;
+		size_t i = (size_t)y*dev->stride + x0;
+		if (dev->frame_index != NULL) {
+			memset(dev->frame_index+i, palette_index(dev, color), x1-x0+1);
+		} else {
+			kern_fill16(dev->frame_buffer+i, FB_COLOR(color), x1-x0+1);
+		}
+		if (dev->damage_mode == DAMAGE_TILE) {
+			frame_damage(dev, x0, y, x1, y);
+			return;
+		}
+		rect_t *b = &dev->fill_box;
+		if (x0 < b->x0) b->x0 = x0;
+		if (x1 > b->x1) b->x1 = x1;
+		if (y < b->y0) b->y0 = y;
+		if (y > b->y1) b->y1 = y;
+	} else if (dev->use_band) {
+		band_fill(dev, x0, y, x1, y, color);
+	} else {
+		span_add(dev, x0, y, x1, y, color);
+	}
+}
+
+static void fill_end(TFT_t *dev)
+{
+	rect_t *b = &dev->fill_box;
+	if (dev->use_frame_buffer && b->x0 <= b->x1)
+		frame_damage(dev, b->x0, b->y0, b->x1, b->y1);
+	span_release(dev);
+}
+
+// Round the x crossing of an edge to nearest instead of truncating it.
+static void edge_round(edge_t *e)
+{
+	e->neg = false;
+	e->r += e->dy >> 1;
+	if (e->r >= e->dy) {e->q++; e->r -= e->dy;}
+}
+
+#define POLY_STACK  16 // polygons with more vertices use the heap
+
+// Non-horizontal polygon edge in the edge table.
+typedef struct {
+	edge_t  e;
+	coord_t x;      // crossing at the current scanline
+	coord_t x0, y0; // top vertex
+	coord_t x1, y1; // bottom vertex, y0 < y1
+	int8_t  dir;    // +1 if the edge goes down, -1 if up
+} poly_edge_t;
+
+static int poly_edge_cmp(const void *a, const void *b)
+{
+	return ((const poly_edge_t *)a)->y0 - ((const poly_edge_t *)b)->y0;
+}
+
+// Fill a polygon of n vertices given as x, y pairs. Edges are sorted by
+// top scanline and moved into an active list as the scanline reaches
+// them. Each scanline sorts the active crossings and fills between them
+// by the even-odd or nonzero rule. An edge covers scanlines y0 to y1-1,
+// except that the bottom row of the polygon also uses the edges ending
+// there, and horizontal edges are drawn as spans, so the outline is
+// included like the other filled primitives.
+static void poly_fill(TFT_t *dev, const coord_t *xy, int n, fill_rule_t rule, color_t color)
+{
+	poly_edge_t pe_stack[POLY_STACK];
+	poly_edge_t *act_stack[POLY_STACK];
+	poly_edge_t *pe = pe_stack, **act = act_stack;
+	int ne = 0, na = 0, next = 0;
+
+	if (n < 3) return;
+	coord_t xmin = xy[0], xmax = xy[0];
+	coord_t ymin = xy[1], ymax = xy[1];
+	for (int i = 1; i < n; i++) {
+		if (xy[2*i] < xmin) xmin = xy[2*i];
+		if (xy[2*i] > xmax) xmax = xy[2*i];
+		if (xy[2*i+1] < ymin) ymin = xy[2*i+1];
+		if (xy[2*i+1] > ymax) ymax = xy[2*i+1];
+	}
+	if (xmax < dev->clip.x0 || xmin > dev->clip.x1) return; // off screen
+	if (ymax < dev->clip.y0 || ymin > dev->clip.y1) return;
+
+	if (n > POLY_STACK) {
+		pe = malloc(n * (sizeof(poly_edge_t) + sizeof(poly_edge_t *)));
+		if (pe == NULL) {
+			ESP_LOGE(TAG, "polygon edge table alloc fail");
+			return;
+		}
+		act = (poly_edge_t **)(pe + n);
+	}
+
+	fill_begin(dev);
+	for (int i = 0; i < n; i++) {
+		coord_t xa = xy[2*i], ya = xy[2*i+1];
+		coord_t xb = xy[2*((i+1)%n)], yb = xy[2*((i+1)%n)+1];
+		if (ya == yb) { // horizontal
+			if (ya >= dev->clip.y0 && ya <= dev->clip.y1) fill_span(dev, xa, xb, ya, color);
+			continue;
+		}
+		poly_edge_t *p = &pe[ne++];
+		p->dir = (ya < yb) ? 1 : -1;
+		if (ya > yb) {swap(coord_t, xa, xb); swap(coord_t, ya, yb);}
+		p->x0 = xa;
+		p->y0 = ya;
+		p->x1 = xb;
+		p->y1 = yb;
+	}
+	qsort(pe, ne, sizeof(poly_edge_t), poly_edge_cmp);
+
+	coord_t ys = (ymin < dev->clip.y0) ? dev->clip.y0 : ymin; // clip
+	coord_t ye = (ymax > dev->clip.y1) ? dev->clip.y1 : ymax;
+	for (coord_t y = ys; y <= ye; y++) {
+		bool last = (y == ymax);
+		int j = 0;
+		for (int i = 0; i < na; i++) { // drop edges that ended
+			if (act[i]->y1 > y || last) act[j++] = act[i];
+		}
+		na = j;
+		for (; next < ne && pe[next].y0 <= y; next++) { // add edges reached
+			poly_edge_t *p = &pe[next];
+			if (p->y1 < y || (p->y1 == y && !last)) continue; // above the clip
+			edge_init(&p->e, p->x0, p->x1 - p->x0, p->y1 - p->y0, y - p->y0);
+			edge_round(&p->e);
+			act[na++] = p;
+		}
+		for (int i = 0; i < na; i++) { // sort crossings, few and nearly sorted
+			poly_edge_t *p = act[i];
+			p->x = edge_x(&p->e);
+			int k = i;
+			for (; k > 0 && act[k-1]->x > p->x; k--) act[k] = act[k-1];
+			act[k] = p;
+		}
+		if (rule == FILL_NONZERO) {
+			for (int i = 0, wind = 0; i < na; i++) {
+				if (wind != 0) fill_span(dev, act[i-1]->x, act[i]->x, y, color);
+				wind += act[i]->dir;
+			}
+		} else {
+			for (int i = 0; i+1 < na; i += 2) {
+				fill_span(dev, act[i]->x, act[i+1]->x, y, color);
+			}
+		}
+		for (int i = 0; i < na; i++) edge_step(&act[i]->e);
+	}
+	fill_end(dev);
+	if (pe != pe_stack) free(pe);
+}
+
+#define CIRCLE_STACK 64 // larger radii use the heap for the width table
+
+// Half-widths of a filled circle of radius r, one per row: hw[k] is the
+// half-width of rows yc-k and yc+k for 0 <= k <= r. The rows match the
+// columns of the midpoint circle, so a fill covers its outline. The
+// outline is the part of each row outside the row below it (toward the
+// center), which is also the pixels of the midpoint circle.
+static void circle_widths(coord_t r, uint16_t *hw)
+{
+	coord_t x = 0;
+	coord_t y = -r;
+	coord_t err = 2-2*r;
+	coord_t old_err;
+
+	do {
+		hw[-y] = x; // y steps by at most one, so every row is written
+		if ((old_err=err)<=x)   err+=++x*2+1;
+		if (old_err>y || err>x) err+=++y*2+1;
+	} while (y<=0);
+}
+
+// Get the half-width table for radius r, r+1 entries. Tables up to
+// CIRCLE_CACHE_R are built on first use and kept. Larger ones are built
+// in stack, which holds CIRCLE_STACK+1 entries, or on the heap, and are
+// released with circle_table_free(). Returns NULL if there is no table.
+static const uint16_t *circle_table(TFT_t *dev, coord_t r, uint16_t *stack)
+{
+	uint16_t *hw;
+
+	if (r < 0 || r > UINT16_MAX) return NULL;
+	if (r <= CIRCLE_CACHE_R) {
+		hw = dev->circle_hw + r*(r+1)/2;
+		if (!(dev->circle_built & (1UL << r))) {
+			circle_widths(r, hw);
+			dev->circle_built |= 1UL << r;
+		}
+		return hw;
+	}
+	hw = stack;
+	if (r > CIRCLE_STACK) {
+		hw = malloc((r+1) * sizeof(uint16_t));
+		if (hw == NULL) {
+			ESP_LOGE(TAG, "circle width table alloc fail");
+			return NULL;
+		}
+	}
+	circle_widths(r, hw);
+	return hw;
+}
+
+static void circle_table_free(coord_t r, const uint16_t *hw)
+{
+	if (r > CIRCLE_STACK) free((void *)hw);
+}
+
+// Fill a rectangle from (x0, y0) to (x1, y1) with rounded corners of
+// radius r as horizontal spans. The corner arcs are centered on
+// (x0+r, y0+r), (x1-r, y0+r), (x0+r, y1-r) and (x1-r, y1-r), so a circle
+// is the case where the rectangle is 2r+1 square.
+static void circle_fill(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+{
+	uint16_t hw_stack[CIRCLE_STACK+1];
+
+	if (x1 < dev->clip.x0 || y1 < dev->clip.y0 || x0 > dev->clip.x1 || y0 > dev->clip.y1) return;
+	const uint16_t *hw = circle_table(dev, r, hw_stack);
+	if (hw == NULL) return;
+
+	coord_t xl = x0+r, xr = x1-r; // arc centers
+	coord_t yt = y0+r, yb = y1-r;
+	fill_begin(dev);
+	for (coord_t k = r; k > 0; k--) {
+		if (yt-k >= dev->clip.y0 && yt-k <= dev->clip.y1)
+			fill_span(dev, xl-hw[k], xr+hw[k], yt-k, color);
+	}
+	coord_t ys = (yt < dev->clip.y0) ? dev->clip.y0 : yt; // clip
+	coord_t ye = (yb > dev->clip.y1) ? dev->clip.y1 : yb;
+	for (coord_t y = ys; y <= ye; y++) {
+		fill_span(dev, x0, x1, y, color);
+	}
+	for (coord_t k = 1; k <= r; k++) {
+		if (yb+k >= dev->clip.y0 && yb+k <= dev->clip.y1)
+			fill_span(dev, xl-hw[k], xr+hw[k], yb+k, color);
+	}
+	fill_end(dev);
+	circle_table_free(r, hw);
+}
+
+// Draw the part of arc row k outside arc row k-1 on row y, mirrored
+// about the arc centers xl and xr. The outermost row is drawn whole.
+static void circle_row(TFT_t *dev, const uint16_t *hw, coord_t r, coord_t k, coord_t xl, coord_t xr, coord_t y, color_t color)
+{
+	if (y < dev->clip.y0 || y > dev->clip.y1) return;
+	coord_t hi = hw[k];
+	coord_t lo = (k < r && hw[k+1] < hi) ? hw[k+1]+1 : hi;
+	if (k == r) lo = 0;
+	if (lo == 0) {
+		fill_span(dev, xl-hi, xr+hi, y, color);
+	} else {
+		fill_span(dev, xl-hi, xl-lo, y, color);
+		fill_span(dev, xr+lo, xr+hi, y, color);
+	}
+}
+
+// Draw the outline of a rectangle with rounded corners, with the same
+// corners as circle_fill().
+static void circle_draw(TFT_t *dev, coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+{
+	uint16_t hw_stack[CIRCLE_STACK+1];
+
+	if (x1 < dev->clip.x0 || y1 < dev->clip.y0 || x0 > dev->clip.x1 || y0 > dev->clip.y1) return;
+	const uint16_t *hw = circle_table(dev, r, hw_stack);
+	if (hw == NULL) return;
+
+	coord_t xl = x0+r, xr = x1-r; // arc centers
+	coord_t yt = y0+r, yb = y1-r;
+	fill_begin(dev);
+	for (coord_t k = r; k > 0; k--) {
+		circle_row(dev, hw, r, k, xl, xr, yt-k, color);
+		circle_row(dev, hw, r, k, xl, xr, yb+k, color);
+	}
+	coord_t ys = (yt < dev->clip.y0) ? dev->clip.y0 : yt; // clip
+	coord_t ye = (yb > dev->clip.y1) ? dev->clip.y1 : yb;
+	for (coord_t y = ys; y <= ye; y++) {
+		if (r == 0 && (y == y0 || y == y1)) {
+			fill_span(dev, x0, x1, y, color);
+		} else {
+			fill_span(dev, x0, x0, y, color);
+			if (x1 != x0) fill_span(dev, x1, x1, y, color);
+		}
+	}
+	fill_end(dev);
+	circle_table_free(r, hw);
+}
+
+//----------------------------------------------------------------------------//
+// Glyph cache
+//----------------------------------------------------------------------------//
+
+// Text with a font background is drawn as one window per string. Each row
+// of the window is assembled in text_line from glyph cells, characters
+// already expanded to colors at the font size and rotated to the font
+// direction. Cells are cached in a direct-mapped table keyed on character,
+// size, direction, foreground and background. The slot is the character
+// offset by a hash of the other keys, so characters of one string never
+// evict each other. Larger font sizes are expanded from the font on each
+// row instead of being cached.
+//
+// Rotated text reads in the font direction. A character at (x, y) covers:
+//   DIRECTION0:   x to x+W-1, y to y+H-1, next character at x+W
+//   DIRECTION90:  x-H+1 to x, y to y+W-1, next character at y+W
+//   DIRECTION180: x-W+1 to x, y-H+1 to y, next character at x-W
+//   DIRECTION270: x to x+H-1, y-W+1 to y, next character at y-W
+// where W and H are the scaled character width and height.
+
+#define TEXT_LINE_MAX ((LCD_W > LCD_H) ? LCD_W : LCD_H)
+static color_t text_line[TEXT_LINE_MAX];
+
+#define TEXT_VERTICAL(d) ((d) == DIRECTION90 || (d) == DIRECTION270)
+
+// Test the font pixel at column c and row r of a character cell in
+// screen orientation, with width cw and height ch in the font direction.
+inline static bool glyph_bit(char ascii, direction_t dir, coord_t s, coord_t c, coord_t r)
+{
+	coord_t i, j; // column and row of the unrotated character
+	switch (dir) {
+	default:
+	case DIRECTION0:   i = c; j = r; break;
+	case DIRECTION90:  i = r; j = LCD_CHAR_H*s-1 - c; break;
+	case DIRECTION180: i = LCD_CHAR_W*s-1 - c; j = LCD_CHAR_H*s-1 - r; break;
+	case DIRECTION270: i = LCD_CHAR_W*s-1 - r; j = c; break;
+	}
+	i /= s; j /= s;
+	if (i == LCD_CHAR_W-1) return false; // spacing column
+	return (font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i] >> j) & 0x1;
+}
+
+// Get the cell for a character at the current font size and direction,
+// or NULL if it can't be cached.
+static const color_t *glyph_get(TFT_t *dev, char ascii, color_t fg, color_t bg)
+{
+	uint8_t s = dev->font_size;
+	uint8_t dir = dev->font_direction;
+	glyph_t *g = &dev->glyph[((uint8_t)ascii + (fg ^ bg) * 31 + dir * 32) & (GLYPH_SLOTS-1)];
+
+	if (g->size == s && g->dir == dir && g->ascii == ascii && g->fg == fg && g->bg == bg)
+		return g->cell;
+	if (s > GLYPH_SIZE_MAX) return NULL;
+
+	coord_t cw = TEXT_VERTICAL(dir) ? LCD_CHAR_H*s : LCD_CHAR_W*s;
+	coord_t ch = TEXT_VERTICAL(dir) ? LCD_CHAR_W*s : LCD_CHAR_H*s;
+	size_t len = (size_t)cw*ch;
+	if (g->cap < len) {
+		color_t *cell = realloc(g->cell, len*sizeof(color_t));
+		if (cell == NULL) return NULL;
+		g->cell = cell;
+		g->cap = len;
+	}
+	g->size = 0; // empty while the cell is rebuilt
+	for (coord_t r = 0; r < ch; r++) {
+		for (coord_t c = 0; c < cw; c++) {
+			g->cell[r*cw + c] = glyph_bit(ascii, dir, s, c, r) ? fg : bg;
+		}
+	}
+	g->size = s;
+	g->dir = dir;
+	g->ascii = ascii;
+	g->fg = fg;
+	g->bg = bg;
+	return g->cell;
+}
+
+// Write columns c0 to c1-1 of row r of a character cell to dst.
+static void glyph_row(TFT_t *dev, color_t *dst, char ascii, coord_t r, coord_t c0, coord_t c1, color_t fg, color_t bg)
+{
+	const color_t *cell = glyph_get(dev, ascii, fg, bg);
+
+	if (cell != NULL) {
+		coord_t cw = LCD_CHAR_W*dev->font_size;
+		if (TEXT_VERTICAL(dev->font_direction)) cw = LCD_CHAR_H*dev->font_size;
+		kern_copy16(dst, cell + r*cw + c0, c1-c0);
+		return;
+	}
+	for (coord_t c = c0; c < c1; c++) {
+		*dst++ = glyph_bit(ascii, dev->font_direction, dev->font_size, c, r) ? fg : bg;
+	}
+}
+
+// Get the screen rectangle covered by n characters at (x, y) in the font
+// direction. Returns the coordinate of a following character.
+static coord_t text_box(TFT_t *dev, coord_t x, coord_t y, size_t n, rect_t *box)
+{
+	coord_t w = (coord_t)n*LCD_CHAR_W*dev->font_size; // along the text
+	coord_t h = LCD_CHAR_H*dev->font_size;            // across the text
+
+	switch (dev->font_direction) {
+	default:
+	case DIRECTION0:
+		*box = (rect_t){x, y, x+w-1, y+h-1};
+		return x+w;
+	case DIRECTION90:
+		*box = (rect_t){x-h+1, y, x, y+w-1};
+		return y+w;
+	case DIRECTION180:
+		*box = (rect_t){x-w+1, y-h+1, x, y};
+		return x-w;
+	case DIRECTION270:
+		*box = (rect_t){x, y-w+1, x+h-1, y};
+		return y-w;
+	}
+}
+
+// Draw n characters with the font background as one clipped window,
+// a row at a time. Returns the coordinate of a following character.
+static coord_t text_draw(TFT_t *dev, coord_t x, coord_t y, const char *ascii, size_t n, color_t color)
+{
+	direction_t dir = dev->font_direction;
+	coord_t cw = LCD_CHAR_W*dev->font_size; // cell size in screen orientation
+	coord_t ch = LCD_CHAR_H*dev->font_size;
+	if (TEXT_VERTICAL(dir)) swap(coord_t, cw, ch);
+
+	rect_t b;
+	coord_t next = text_box(dev, x, y, n, &b);
+	if (b.x1 < dev->clip.x0 || b.x0 > dev->clip.x1) return next; // off screen
+	if (b.y1 < dev->clip.y0 || b.y0 > dev->clip.y1) return next;
+
+	coord_t x0 = (b.x0 < dev->clip.x0) ? dev->clip.x0 : b.x0; // clip
+	coord_t x1 = (b.x1 > dev->clip.x1) ? dev->clip.x1 : b.x1;
+	coord_t y0 = (b.y0 < dev->clip.y0) ? dev->clip.y0 : b.y0;
+	coord_t y1 = (b.y1 > dev->clip.y1) ? dev->clip.y1 : b.y1;
+
+	bool direct = !dev->use_frame_buffer && !dev->use_band;
+	if (direct) {
+		span_flush(dev);
+		spi_master_write_window(dev, x0+dev->winx, y0+dev->winy,
+			x1+dev->winx, y1+dev->winy);
+	}
+	for (coord_t yr = y0; yr <= y1; yr++) {
+		coord_t gy = (yr-b.y0)/ch, r = (yr-b.y0) - gy*ch;
+		// A canvas can be wider than text_line, so long rows go in pieces.
+		for (coord_t s0 = x0; s0 <= x1; s0 += TEXT_LINE_MAX) {
+			coord_t s1 = (x1-s0 >= TEXT_LINE_MAX) ? s0+TEXT_LINE_MAX-1 : x1;
+			coord_t w = s1-s0+1;
+			for (coord_t px = s0; px <= s1; ) {
+				coord_t gx = (px-b.x0)/cw, c0 = (px-b.x0) - gx*cw;
+				coord_t c1 = (s1+1 - (b.x0+gx*cw) < cw) ? s1+1 - (b.x0+gx*cw) : cw;
+				size_t k; // character in the cell, first character at (x, y)
+				switch (dir) {
+				default:
+				case DIRECTION0:   k = gx; break;
+				case DIRECTION90:  k = gy; break;
+				case DIRECTION180: k = n-1 - gx; break;
+				case DIRECTION270: k = n-1 - gy; break;
+				}
+				glyph_row(dev, text_line+(px-s0), ascii[k], r, c0, c1,
+					color, dev->font_back_color);
+				px += c1-c0;
+			}
+			if (dev->use_frame_buffer) frame_copy(dev, s0, yr, w, text_line);
+			else if (dev->use_band) band_copy(dev, s0, yr, w, text_line);
+			else spi_master_write_colors(dev, text_line, w);
+		}
+	}
+	return next;
+}
+
 //----------------------------------------------------------------------------//
 // LCD
 //----------------------------------------------------------------------------//
@@ -264,14 +1628,35 @@ void lcd_init(void)
 
 	dev->width = LCD_W;
 	dev->height = LCD_H;
+	dev->stride = LCD_W;
+	dev->canvas = NULL;
 	dev->offsetx = LCD_OFFSETX;
 	dev->offsety = LCD_OFFSETY;
+	dev->view = (rect_t){0, 0, LCD_W-1, LCD_H-1};
+	dev->orgx = 0;
+	dev->orgy = 0;
+	clip_update(dev);
 	dev->font_direction = DIRECTION0;
 	dev->font_size = 1;
 	dev->font_back_en = false;
 	dev->font_back_color = BLACK;
 	dev->use_frame_buffer = false;
+	dev->frame_swap = false;
 	dev->frame_buffer = NULL;
+	dev->frame_index = NULL;
+	dev->front_buf[0] = NULL;
+	dev->front_buf[1] = NULL;
+	dev->front_fail = false;
+	dev->damage_mode = DAMAGE_RECT;
+	frame_damage_clear(dev);
+	dev->span_hold = 0;
+	dev->span_cnt = 0;
+	dev->scroll_top = 0;
+	dev->scroll_height = 0;
+	dev->use_band = false;
+	dev->band_list = NULL;
+	dev->band_buf[0] = NULL;
+	dev->band_buf[1] = NULL;
 
 #if LCD_DRIVER == 0
 	// spi_master_write_command(dev, 0x01);    // ILI:Software Reset (01h), ST:SWRESET (01h): Software Reset
@@ -427,102 +1812,92 @@ void lcd_init(void)
 
 void lcd_fillScreen(color_t color)
 {
-	if (dev->use_frame_buffer) {
-		color_t *ptr = dev->frame_buffer;
-		size_t len = (size_t)dev->width*dev->height;
-		*ptr++ = color; len--;
-		while (len) {
-			size_t n = (len < ptr - dev->frame_buffer) ? len : ptr - dev->frame_buffer;
-			memcpy(ptr, dev->frame_buffer, n*sizeof(color_t));
-			ptr += n; len -= n;
-		}
+	rect_t *v = &dev->view;
+	if (v->x0 > 0 || v->y0 > 0 || v->x1 < dev->width-1 || v->y1 < dev->height-1) {
+		if (v->x0 <= v->x1 && v->y0 <= v->y1)
+			lcd_fillRect(dev->clip.x0, dev->clip.y0, v->x1-v->x0+1, v->y1-v->y0+1, color);
+		return;
+	}
+	if (dev->frame_index != NULL) {
+		memset(dev->frame_index, palette_index(dev, color), (size_t)dev->width*dev->height);
+		frame_damage_all(dev);
+	} else if (dev->use_frame_buffer) {
+		kern_fill_rect16(dev->frame_buffer, dev->stride, dev->width, dev->height, FB_COLOR(color));
+		frame_damage_all(dev);
+	} else if (dev->use_band) {
+		band_clear(dev, color);
 	} else {
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, 0, dev->width-1);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, 0, dev->height-1);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		span_flush(dev);
+		spi_master_write_window(dev, 0, 0, dev->width-1, dev->height-1);
 		spi_master_write_color(dev, color, (size_t)dev->width*dev->height);
 	}
 }
 
 void lcd_drawPixel(coord_t x, coord_t y, color_t color)
 {
-	if (x < 0 || x >= dev->width) return; // off screen
-	if (y < 0 || y >= dev->height) return;
+	if (x < dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y < dev->clip.y0 || y > dev->clip.y1) return;
 
 	if (dev->use_frame_buffer) {
-		dev->frame_buffer[y*dev->width+x] = color;
+		frame_fill(dev, x, y, x, y, color);
+	} else if (dev->use_band) {
+		band_fill(dev, x, y, x, y, color);
+	} else if (dev->span_hold) {
+		span_add(dev, x, y, x, y, color);
 	} else {
-		coord_t _x = x + dev->offsetx;
-		coord_t _y = y + dev->offsety;
-
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x, _x);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y, _y);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		coord_t _x = x + dev->winx;
+		coord_t _y = y + dev->winy;
+
+		spi_master_write_window(dev, _x, _y, _x, _y);
 		spi_master_write_colors(dev, &color, 1);
 	}
 }
 
 void lcd_drawHPixels(coord_t x, coord_t y, coord_t w, const color_t *colors)
 {
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y < 0 || y >= dev->height) return;
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y < dev->clip.y0 || y > dev->clip.y1) return;
 
-	if (x < 0) {w += x; x = 0;} // clip
-	if (x+w > dev->width) w = dev->width-x;
+	if (x < dev->clip.x0) {colors += dev->clip.x0-x; w -= dev->clip.x0-x; x = dev->clip.x0;} // clip
+	if (x+w-1 > dev->clip.x1) w = dev->clip.x1+1-x;
 
 	if (dev->use_frame_buffer) {
-		coord_t _x1 = x;
-		coord_t _x2 = _x1 + (w-1);
-		coord_t index = 0;
-		size_t fbidx = (size_t)y*dev->width;
-		for (coord_t i = _x1; i <= _x2; i++){
-			dev->frame_buffer[fbidx+i] = colors[index++];
-		}
+		frame_copy(dev, x, y, w, colors);
+	} else if (dev->use_band) {
+		band_copy(dev, x, y, w, colors);
 	} else {
-		coord_t _x1 = x + dev->offsetx;
+		span_flush(dev);
+		coord_t _x1 = x + dev->winx;
 		coord_t _x2 = _x1 + (w-1);
-		coord_t _y1 = y + dev->offsety;
+		coord_t _y1 = y + dev->winy;
 		coord_t _y2 = _y1;
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		spi_master_write_window(dev, _x1, _y1, _x2, _y2);
 		spi_master_write_colors(dev, colors, w);
 	}
 }
 
 void lcd_drawHLine(coord_t x, coord_t y, coord_t w, color_t color)
 {
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y < 0 || y >= dev->height) return;
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y < dev->clip.y0 || y > dev->clip.y1) return;
 
-	if (x < 0) {w += x; x = 0;} // clip
-	if (x+w > dev->width) w = dev->width-x;
+	if (x < dev->clip.x0) {w -= dev->clip.x0-x; x = dev->clip.x0;} // clip
+	if (x+w-1 > dev->clip.x1) w = dev->clip.x1+1-x;
 
 	if (dev->use_frame_buffer) {
-		coord_t _x1 = x;
-		coord_t _x2 = _x1 + (w-1);
-		size_t fbidx = (size_t)y*dev->width;
-		for (coord_t i = _x1; i <= _x2; i++){
-			dev->frame_buffer[fbidx+i] = color;
-		}
+		frame_fill(dev, x, y, x+w-1, y, color);
+	} else if (dev->use_band) {
+		band_fill(dev, x, y, x+w-1, y, color);
+	} else if (dev->span_hold) {
+		span_add(dev, x, y, x+w-1, y, color);
 	} else {
-		coord_t _x1 = x + dev->offsetx;
+		coord_t _x1 = x + dev->winx;
 		coord_t _x2 = _x1 + (w-1);
-		coord_t _y1 = y + dev->offsety;
+		coord_t _y1 = y + dev->winy;
 		coord_t _y2 = _y1;
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		spi_master_write_window(dev, _x1, _y1, _x2, _y2);
 		spi_master_write_color(dev, color, w);
 	}
 }
@@ -530,28 +1905,26 @@ void lcd_drawHLine(coord_t x, coord_t y, coord_t w, color_t color)
 void lcd_drawVLine(coord_t x, coord_t y, coord_t h, color_t color)
 {
 	coord_t y2 = y+h-1;
-	if (x < 0 || x  >= dev->width) return; // off screen
-	if (y2 < 0 || y >= dev->height) return;
+	if (x < dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y2 < dev->clip.y0 || y > dev->clip.y1) return;
 
-	if (y < 0) y = 0; // clip
-	if (y2 >= dev->height) y2 = dev->height-1;
+	if (y < dev->clip.y0) y = dev->clip.y0; // clip
+	if (y2 > dev->clip.y1) y2 = dev->clip.y1;
 
 	if (dev->use_frame_buffer) {
-		for (size_t j = y; j <= y2; j++){
-			dev->frame_buffer[j*dev->width+x] = color;
-		}
+		frame_fill(dev, x, y, x, y2, color);
+	} else if (dev->use_band) {
+		band_fill(dev, x, y, x, y2, color);
+	} else if (dev->span_hold) {
+		span_add(dev, x, y, x, y2, color);
 	} else {
-		coord_t _x1 =  x  + dev->offsetx;
-		coord_t _x2 = _x1 + dev->offsetx;
-		coord_t _y1 =  y  + dev->offsety;
-		coord_t _y2 =  y2 + dev->offsety;
+		coord_t _x1 =  x  + dev->winx;
+		coord_t _x2 = _x1;
+		coord_t _y1 =  y  + dev->winy;
+		coord_t _y2 =  y2 + dev->winy;
 		size_t size = _y2-_y1+1;
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x1, _x2);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y1, _y2);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		spi_master_write_window(dev, _x1, _y1, _x2, _y2);
 		spi_master_write_color(dev, color, size);
 	}
 }
@@ -559,13 +1932,26 @@ void lcd_drawVLine(coord_t x, coord_t y, coord_t h, color_t color)
 /**
  * @note Bresenham's algorithm from Wikipedia. Speed enhanced by Bodmer to use
  *  efficient H/V Line draw routines for line segments of 2 pixels or more.
+ * @details Cohen-Sutherland outcodes reject a line with both ends beyond
+ *  the same edge of the clip rectangle and accept one with both ends
+ *  inside. Otherwise the edges crossed are intersected in Bresenham step
+ *  space rather than at real coordinates: the first and last visible
+ *  steps along the major axis are solved directly, and the error term is
+ *  set up at the first one, so only visible pixels are visited and they
+ *  are the same pixels the unclipped line would draw.
  */
 void lcd_drawLine(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
 {
+	uint8_t code0 = clip_code(dev, x0, y0);
+	uint8_t code1 = clip_code(dev, x1, y1);
+	if (code0 & code1) return; // off screen
+
 	bool steep = abs(y1 - y0) > abs(x1 - x0);
+	rect_t c = dev->clip; // in the major, minor axis order
 	if (steep) {
 		swap(coord_t, x0, y0);
 		swap(coord_t, x1, y1);
+		c = (rect_t){c.y0, c.x0, c.y1, c.x1};
 	}
 
 	if (x0 > x1) {
@@ -579,6 +1965,35 @@ void lcd_drawLine(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color)
 
 	if (y0 < y1) ystep = 1;
 
+	if (code0 | code1) {
+		// After k steps the minor axis has moved m(k) = (k*dy + b)/dx
+		// times, with b = dx-1-err. Find the steps k0 to k1 where both
+		// axes are inside the clip rectangle.
+		int64_t b = dx-1-err;
+		coord_t k0 = (x0 < c.x0) ? c.x0-x0 : 0;
+		coord_t k1 = (x1 > c.x1) ? c.x1-x0 : dx;
+		coord_t lo = (ystep > 0) ? c.y0-y0 : y0-c.y1; // visible m range
+		coord_t hi = (ystep > 0) ? c.y1-y0 : y0-c.y0;
+		if (hi < 0) return;
+		if (dy == 0) {
+			if (lo > 0) return;
+		} else {
+			if (lo > 0) { // m(k) >= lo
+				coord_t k = ((int64_t)lo*dx - b + dy-1) / dy;
+				if (k > k0) k0 = k;
+			}
+			coord_t k = ((int64_t)hi*dx + err) / dy; // m(k) <= hi
+			if (k < k1) k1 = k;
+		}
+		if (k0 > k1) return; // misses the clip rectangle
+		coord_t m = (dx) ? ((int64_t)k0*dy + b) / dx : 0;
+		err += m*dx - k0*dy;
+		y0 += m*ystep;
+		x1 = x0 + k1;
+		x0 += k0;
+		xs = x0;
+	}
+
 	// Split into steep and not steep for FastH/V separation
 	if (steep) {
 		for (; x0 <= x1; x0++) {
@@ -624,32 +2039,28 @@ void lcd_fillRect(coord_t x, coord_t y, coord_t w, coord_t h, color_t color)
 	coord_t x1 = x+w-1;
 	coord_t y1 = y+h-1;
 
-	if (x1 < 0 || x >= dev->width) return; // off screen
-	if (y1 < 0 || y >= dev->height) return;
+	if (x1 < dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y1 < dev->clip.y0 || y > dev->clip.y1) return;
 
-	if (x < 0) x = 0; // clip
-	if (x1 >= dev->width) x1=dev->width-1;
-	if (y < 0) y = 0;
-	if (y1 >= dev->height) y1=dev->height-1;
+	if (x < dev->clip.x0) x = dev->clip.x0; // clip
+	if (x1 > dev->clip.x1) x1 = dev->clip.x1;
+	if (y < dev->clip.y0) y = dev->clip.y0;
+	if (y1 > dev->clip.y1) y1 = dev->clip.y1;
 
 	if (dev->use_frame_buffer) {
-		for (size_t j = y; j <= y1; j++){
-			for (size_t i = x; i <= x1; i++){
-				dev->frame_buffer[j*dev->width+i] = color;
-			}
-		}
+		frame_fill(dev, x, y, x1, y1, color);
+	} else if (dev->use_band) {
+		band_fill(dev, x, y, x1, y1, color);
+	} else if (dev->span_hold) {
+		span_add(dev, x, y, x1, y1, color);
 	} else {
-		coord_t _x0 = x  + dev->offsetx;
-		coord_t _x1 = x1 + dev->offsetx;
-		coord_t _y0 = y  + dev->offsety;
-		coord_t _y1 = y1 + dev->offsety;
+		coord_t _x0 = x  + dev->winx;
+		coord_t _x1 = x1 + dev->winx;
+		coord_t _y0 = y  + dev->winy;
+		coord_t _y1 = y1 + dev->winy;
 		size_t size = (size_t)(_x1-_x0+1)*(_y1-_y0+1);
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x0, _x1);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y0, _y1);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		spi_master_write_window(dev, _x0, _y0, _x1, _y1);
 		spi_master_write_color(dev, color, size);
 	}
 }
@@ -662,7 +2073,10 @@ void lcd_drawTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2
 }
 
 /**
- * @note Original Adafruit function works well and code footprint is small.
+ * @details Scanlines are clipped to the clip rectangle once, then the two edges
+ *  crossing each scanline are stepped without division and the span
+ *  between them is written directly. Output matches the Adafruit version
+ *  this replaced, which divided on every scanline.
  */
 void lcd_fillTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2, coord_t y2, color_t color)
 {
@@ -679,162 +2093,82 @@ void lcd_fillTriangle(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t x2
 		swap(coord_t, y0, y1); swap(coord_t, x0, x1);
 	}
 
+	a = b = x0; // bounding box columns
+	if (x1 < a)      a = x1;
+	else if (x1 > b) b = x1;
+	if (x2 < a)      a = x2;
+	else if (x2 > b) b = x2;
+	if (b < dev->clip.x0 || a > dev->clip.x1) return; // off screen
+	if (y2 < dev->clip.y0 || y0 > dev->clip.y1) return;
+
 	if (y0 == y2) { // Handle awkward all-on-same-line case as its own thing
-		a = b = x0;
-		if (x1 < a)      a = x1;
-		else if (x1 > b) b = x1;
-		if (x2 < a)      a = x2;
-		else if (x2 > b) b = x2;
 		lcd_drawHLine(a, y0, b - a + 1, color);
 		return;
 	}
 
-	coord_t
-	dx01 = x1 - x0,
-	dy01 = y1 - y0,
-	dx02 = x2 - x0,
-	dy02 = y2 - y0,
-	dx12 = x2 - x1,
-	dy12 = y2 - y1,
-	sa   = 0,
-	sb   = 0;
-
-	// For upper part of triangle, find scanline crossings for segments
-	// 0-1 and 0-2. If y1=y2 (flat-bottomed triangle), the scanline y1
-	// is included here (and second loop will be skipped, avoiding a /0
-	// error there), otherwise scanline y1 is skipped here and handled
-	// in the second loop...which also avoids a /0 error here if y0=y1
-	// (flat-topped triangle).
+	coord_t ys = (y0 < dev->clip.y0) ? dev->clip.y0 : y0; // clip
+	coord_t ye = (y2 > dev->clip.y1) ? dev->clip.y1 : y2;
+	edge_t e01, e02, e12;
+
+	// For upper part of triangle, use edges 0-1 and 0-2. If y1=y2
+	// (flat-bottomed triangle), the scanline y1 is included here,
+	// otherwise it is the first scanline of the lower part, which uses
+	// edges 1-2 and 0-2. Neither part steps an edge with dy=0.
 	if (y1 == y2) last = y1; // Include y1 scanline
 	else          last = y1 - 1; // Skip it
 
-	for (y = y0; y <= last; y++) {
-		a   = x0 + sa / dy01;
-		b   = x0 + sb / dy02;
-		sa += dx01;
-		sb += dx02;
-
-		if (a > b) swap(coord_t, a, b);
-		lcd_drawHLine(a, y, b - a + 1, color);
+	fill_begin(dev);
+	y = ys;
+	edge_init(&e02, x0, x2 - x0, y2 - y0, y - y0);
+	if (y <= last) {
+		edge_init(&e01, x0, x1 - x0, y1 - y0, y - y0);
+		for (; y <= last && y <= ye; y++) {
+			fill_span(dev, edge_x(&e01), edge_x(&e02), y, color);
+			edge_step(&e01);
+			edge_step(&e02);
+		}
 	}
-
-	// For lower part of triangle, find scanline crossings for segments
-	// 0-2 and 1-2. This loop is skipped if y1=y2.
-	sa = dx12 * (y - y1);
-	sb = dx02 * (y - y0);
-	for (; y <= y2; y++) {
-		a   = x1 + sa / dy12;
-		b   = x0 + sb / dy02;
-		sa += dx12;
-		sb += dx02;
-
-		if (a > b) swap(coord_t, a, b);
-		lcd_drawHLine(a, y, b - a + 1, color);
+	if (y <= ye) {
+		edge_init(&e12, x1, x2 - x1, y2 - y1, y - y1);
+		for (; y <= ye; y++) {
+			fill_span(dev, edge_x(&e12), edge_x(&e02), y, color);
+			edge_step(&e12);
+			edge_step(&e02);
+		}
 	}
+	fill_end(dev);
 }
 
 void lcd_drawCircle(coord_t xc, coord_t yc, coord_t r, color_t color)
 {
-	coord_t x;
-	coord_t y;
-	coord_t err;
-	coord_t old_err;
-
-	x=0;
-	y=-r;
-	err=2-2*r;
-	do {
-		lcd_drawPixel(xc-x, yc+y, color);
-		lcd_drawPixel(xc-y, yc-x, color);
-		lcd_drawPixel(xc+x, yc-y, color);
-		lcd_drawPixel(xc+y, yc+x, color);
-		if ((old_err=err)<=x)   err+=++x*2+1;
-		if (old_err>y || err>x) err+=++y*2+1;
-	} while (y<0);
+	circle_draw(dev, xc-r, yc-r, xc+r, yc+r, r, color);
 }
 
 void lcd_fillCircle(coord_t xc, coord_t yc, coord_t r, color_t color)
 {
-	coord_t x;
-	coord_t y;
-	coord_t err;
-	coord_t old_err;
-	coord_t ChangeX;
+	circle_fill(dev, xc-r, yc-r, xc+r, yc+r, r, color);
+}
 
-	x=0;
-	y=-r;
-	err=2-2*r;
-	ChangeX=1;
-	do {
-		if (ChangeX) {
-			lcd_drawVLine(xc-x, yc+y, (-y<<1)+1, color);
-			lcd_drawVLine(xc+x, yc+y, (-y<<1)+1, color);
-		}
-		ChangeX=(old_err=err)<=x;
-		if (ChangeX)            err+=++x*2+1;
-		if (old_err>y || err>x) err+=++y*2+1;
-	} while (y<=0);
+coord_t lcd_circleSpans(coord_t r, coord_t *hw)
+{
+	uint16_t hw_stack[CIRCLE_STACK+1];
+	const uint16_t *t = circle_table(dev, r, hw_stack);
+	if (t == NULL) return 0;
+	for (coord_t k = 0; k <= r; k++) hw[k] = t[k];
+	circle_table_free(r, t);
+	return r+1;
 }
 
 void lcd_drawRoundRect(coord_t x, coord_t y, coord_t w, coord_t h, coord_t r, color_t color)
 {
-	coord_t x1 = x+w-1;
-	coord_t y1 = y+h-1;
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
-
-	w -= (r<<1);
-	h -= (r<<1);
-	if (w < 1 || h < 1) return;
-
-	xa=0;
-	ya=-r;
-	err=2-2*r;
-
-	do {
-		if (xa) {
-			lcd_drawPixel(x+r-xa,  y+r+ya,  color);
-			lcd_drawPixel(x1-r+xa, y+r+ya,  color);
-			lcd_drawPixel(x+r-xa,  y1-r-ya, color);
-			lcd_drawPixel(x1-r+xa, y1-r-ya, color);
-		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_drawHLine(x+r, y,   w, color);
-	lcd_drawHLine(x+r, y1,  w, color);
-	lcd_drawVLine(x,   y+r, h, color);
-	lcd_drawVLine(x1,  y+r, h, color);
+	if (w-(r<<1) < 1 || h-(r<<1) < 1) return;
+	circle_draw(dev, x, y, x+w-1, y+h-1, r, color);
 }
 
 void lcd_fillRoundRect(coord_t x, coord_t y, coord_t w, coord_t h, coord_t r, color_t color)
 {
-	// coord_t x1 = x+w-1;
-	coord_t y1 = y+h-1;
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
-
-	coord_t w1 = w-(r<<1);
-	coord_t h1 = h-(r<<1);
-	if (w1 < 1 || h1 < 1) return;
-
-	xa=0;
-	ya=-r;
-	err=2-2*r;
-
-	do {
-		if (xa) {
-			lcd_drawHLine(x+r-xa, y +r+ya, w1+(xa<<1), color);
-			lcd_drawHLine(x+r-xa, y1-r-ya, w1+(xa<<1), color);
-		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_fillRect(x, y+r, w, h1, color);
+	if (w-(r<<1) < 1 || h-(r<<1) < 1) return;
+	circle_fill(dev, x, y, x+w-1, y+h-1, r, color);
 }
 
 /**
@@ -891,30 +2225,267 @@ void lcd_fillArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, co
 	lcd_fillTriangle(x1, y1, L[0], L[1], R[0], R[1], color);
 }
 
-void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
+/**
+ * @details Edges are kept in a table sorted by their top scanline and
+ *  each scanline is filled in one pass, so every pixel is written once.
+ */
+void lcd_fillPolygon(const coord_t *xy, int n, fill_rule_t rule, color_t color)
+{
+	poly_fill(dev, xy, n, rule, color);
+}
+
+// Leading zero bits in a byte, b != 0.
+#define CLZ8(b) (__builtin_clz((uint32_t)(b)) - 24)
+
+/**
+ * @details The bitmap is clipped once, then each row is scanned a byte at
+ *  a time for runs of set bits. Each run is drawn as one horizontal line,
+ *  so clear bytes are skipped and set bytes extend the run in one step.
+ */
+void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
+{
+	coord_t byteWidth = (w + 7) / 8; // pad bitmap scanline to whole byte
+
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y+h <= dev->clip.y0 || y > dev->clip.y1) return;
+
+	coord_t i0 = (x < dev->clip.x0) ? dev->clip.x0-x : 0; // clip to bitmap columns and rows
+	coord_t i1 = (x+w-1 > dev->clip.x1) ? dev->clip.x1+1-x : w;
+	coord_t j0 = (y < dev->clip.y0) ? dev->clip.y0-y : 0;
+	coord_t j1 = (y+h-1 > dev->clip.y1) ? dev->clip.y1+1-y : h;
+
+	span_hold(dev);
+	for (coord_t j = j0; j < j1; j++) {
+		const uint8_t *row = bitmap + j * byteWidth;
+		for (coord_t i = i0; i < i1; ) {
+			uint8_t b = row[i >> 3] << (i & 7);
+			if (b == 0) {i = (i | 7) + 1; continue;} // rest of byte clear
+			i += CLZ8(b);
+			if (i >= i1) break;
+			coord_t s = i;
+			for (;;) { // extend the run while bits are set
+				uint8_t c = ~(row[i >> 3] << (i & 7));
+				coord_t r = 8 - (i & 7);
+				coord_t n = c ? CLZ8(c) : 8;
+				if (n < r) {i += n; break;}
+				i += r;
+				if (i >= i1) break;
+			}
+			if (i > i1) i = i1;
+			lcd_drawHLine(x + s, y + j, i - s, color);
+		}
+	}
+	span_release(dev);
+}
+
+#define BITMAP_CHUNK 64 // pixels expanded at a time for frame and band modes
+
+/**
+ * @details In direct mode the clipped bitmap is written as one window and
+ *  a single stream of color data.
+ */
+void lcd_drawBitmapBg(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color, color_t bg)
+{
+	coord_t byteWidth = (w + 7) / 8; // pad bitmap scanline to whole byte
+
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y+h <= dev->clip.y0 || y > dev->clip.y1) return;
+
+	coord_t i0 = (x < dev->clip.x0) ? dev->clip.x0-x : 0; // clip to bitmap columns and rows
+	coord_t i1 = (x+w-1 > dev->clip.x1) ? dev->clip.x1+1-x : w;
+	coord_t j0 = (y < dev->clip.y0) ? dev->clip.y0-y : 0;
+	coord_t j1 = (y+h-1 > dev->clip.y1) ? dev->clip.y1+1-y : h;
+	const uint8_t *row = bitmap + j0 * byteWidth;
+
+	if (dev->use_frame_buffer || dev->use_band) {
+		color_t line[BITMAP_CHUNK];
+		for (coord_t j = j0; j < j1; j++, row += byteWidth) {
+			for (coord_t i = i0; i < i1; i += BITMAP_CHUNK) {
+				coord_t n = (i1-i < BITMAP_CHUNK) ? i1-i : BITMAP_CHUNK;
+				bitmap_expand(line, row, i, n, color, bg);
+				if (dev->use_frame_buffer) frame_copy(dev, x+i, y+j, n, line);
+				else band_copy(dev, x+i, y+j, n, line);
+			}
+		}
+	} else {
+		span_flush(dev);
+		coord_t _x1 = x + i0 + dev->winx;
+		coord_t _x2 = x + i1-1 + dev->winx;
+		coord_t _y1 = y + j0 + dev->winy;
+		coord_t _y2 = y + j1-1 + dev->winy;
+
+		spi_master_write_window(dev, _x1, _y1, _x2, _y2);
+		spi_master_write_bits(dev, row, byteWidth, i0, i1-i0, j1-j0, color, bg);
+	}
+}
+
+// Draw a w x h image whose rows are stride elements apart. The source
+// rectangle is clipped once. In direct mode it is written as one window
+// and a single stream of color data.
+static void draw_image(TFT_t *dev, coord_t x, coord_t y, const color_t *bitmap, coord_t stride, coord_t w, coord_t h)
+{
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y+h <= dev->clip.y0 || y > dev->clip.y1) return;
+
+	coord_t x0 = (x < dev->clip.x0) ? dev->clip.x0 : x; // clip
+	coord_t y0 = (y < dev->clip.y0) ? dev->clip.y0 : y;
+	coord_t x1 = (x+w-1 > dev->clip.x1) ? dev->clip.x1 : x+w-1;
+	coord_t y1 = (y+h-1 > dev->clip.y1) ? dev->clip.y1 : y+h-1;
+	const color_t *src = bitmap + (y0-y)*stride + (x0-x);
+
+	if (dev->use_frame_buffer) {
+		frame_image(dev, x0, y0, x1, y1, src, stride);
+	} else if (dev->use_band) { // record by reference
+		band_image(dev, x0, y0, x1, y1, src, stride);
+	} else {
+		span_flush(dev);
+		coord_t _x0 = x0 + dev->winx;
+		coord_t _x1 = x1 + dev->winx;
+		coord_t _y0 = y0 + dev->winy;
+		coord_t _y1 = y1 + dev->winy;
+
+		spi_master_write_window(dev, _x0, _y0, _x1, _y1);
+		spi_master_write_rect(dev, src, stride, x1-x0+1, y1-y0+1, false);
+	}
+}
+
+/**
+ * @details The source rectangle is clipped once. In direct mode it is
+ *  written as one window and a single stream of color data.
+ */
+void lcd_drawRGBBitmap(coord_t x, coord_t y, const color_t *bitmap, coord_t w, coord_t h)
 {
-	coord_t byteWidth = (w + 7) / 8; // pad bitmap scanline to whole byte
-	uint8_t b = 0;
-
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y+h <= 0 || y >= dev->height) return;
+	draw_image(dev, x, y, bitmap, w, w, h);
+}
 
-	for (size_t j = 0; j < h; j++, y++) {
-		for (size_t i = 0; i < w; i++) {
-			if (i & 7) b <<= 1;
-			else b = bitmap[j * byteWidth + i / 8];
-			if (b & 0x80) lcd_drawPixel(x + i, y, color);
+bool lcd_readRGBBitmap(coord_t x, coord_t y, color_t *bitmap, coord_t w, coord_t h)
+{
+	if (!dev->use_frame_buffer) return false;
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return true; // off screen
+	if (y+h <= dev->clip.y0 || y > dev->clip.y1) return true;
+
+	coord_t x0 = (x < dev->clip.x0) ? dev->clip.x0 : x; // clip
+	coord_t y0 = (y < dev->clip.y0) ? dev->clip.y0 : y;
+	coord_t x1 = (x+w-1 > dev->clip.x1) ? dev->clip.x1 : x+w-1;
+	coord_t y1 = (y+h-1 > dev->clip.y1) ? dev->clip.y1 : y+h-1;
+	color_t *dst = bitmap + (y0-y)*w + (x0-x);
+	size_t fbidx = (size_t)(y0+dev->orgy)*dev->stride + (x0+dev->orgx);
+	coord_t n = x1-x0+1;
+
+	for (coord_t r = y0; r <= y1; r++, dst += w, fbidx += dev->stride) {
+		if (dev->frame_index != NULL) {
+			for (coord_t i = 0; i < n; i++) {
+				dst[i] = dev->pal_key[dev->frame_index[fbidx+i]];
+			}
+		} else if (dev->frame_swap) {
+			kern_copy16_swap(dst, dev->frame_buffer+fbidx, n);
+		} else {
+			kern_copy16(dst, dev->frame_buffer+fbidx, n);
 		}
 	}
+	return true;
 }
 
-void lcd_drawRGBBitmap(coord_t x, coord_t y, const color_t *bitmap, coord_t w, coord_t h)
+// Get line buffer i of lcd_drawLines(), allocating it on first use.
+// Returns NULL if there is no memory for it.
+static color_t *line_buffer(TFT_t *dev, uint8_t i)
 {
-	if (x+w <= 0 || x >= dev->width) return; // off screen
-	if (y+h <= 0 || y >= dev->height) return;
+	if (dev->line_buf[i] == NULL && !dev->line_fail[i]) {
+		size_t size = sizeof(color_t)*LCD_W*LINE_GROUP; // screen width, not the canvas
+		dev->line_buf[i] = heap_caps_malloc(size, MALLOC_CAP_DMA);
+		if (dev->line_buf[i] == NULL) {
+			ESP_LOGW(TAG, "line buffer %u alloc fail, drawing without it", i);
+			dev->line_fail[i] = true;
+		}
+	}
+	return dev->line_buf[i];
+}
 
-	for (size_t j = 0; j < h; j++, y++) {
-		lcd_drawHPixels(x, y, w, bitmap+j*w);
+/**
+ * @details Buffers are allocated on first use and only by the paths that
+ *  need them: the indexed frame buffer and band modes take one row at a
+ *  time through line_buf[0], and direct mode alternates groups of
+ *  LINE_GROUP rows between line_buf[0] and line_buf[1]. A group is
+ *  converted to panel byte order in place and queued as one transaction,
+ *  then the other buffer is filled while it is sent. The RGB frame buffer
+ *  is written in place. If a buffer cannot be allocated, rows are produced
+ *  in pieces of LINE_PART pixels on the stack, or direct mode waits for
+ *  its single buffer to be sent before refilling it.
+ */
+void lcd_drawLines(coord_t x, coord_t y, coord_t w, coord_t h, lcd_line_t line, void *arg)
+{
+	if (x+w <= dev->clip.x0 || x > dev->clip.x1) return; // off screen
+	if (y+h <= dev->clip.y0 || y > dev->clip.y1) return;
+
+	coord_t x0 = (x < dev->clip.x0) ? dev->clip.x0 : x; // clip
+	coord_t y0 = (y < dev->clip.y0) ? dev->clip.y0 : y;
+	coord_t x1 = (x+w-1 > dev->clip.x1) ? dev->clip.x1 : x+w-1;
+	coord_t y1 = (y+h-1 > dev->clip.y1) ? dev->clip.y1 : y+h-1;
+	coord_t n = x1-x0+1;
+	color_t part[LINE_PART]; // used when there is no line buffer
+
+	if (dev->use_frame_buffer && dev->frame_index == NULL) {
+		size_t fbidx = (size_t)(y0+dev->orgy)*dev->stride + (x0+dev->orgx);
+		for (coord_t r = y0; r <= y1; r++, fbidx += dev->stride) {
+			color_t *dst = dev->frame_buffer+fbidx;
+			line(arg, dst, x0-x, r-y, n);
+			if (dev->frame_swap) kern_copy16_swap(dst, dst, n);
+		}
+		frame_damage(dev, x0+dev->orgx, y0+dev->orgy, x1+dev->orgx, y1+dev->orgy);
+	} else if (dev->use_frame_buffer || dev->use_band) {
+		color_t *tmp = line_buffer(dev, 0);
+		coord_t len = (tmp != NULL) ? n : LINE_PART;
+		if (tmp == NULL) tmp = part;
+		size_t fbidx = (size_t)(y0+dev->orgy)*dev->stride + (x0+dev->orgx);
+		for (coord_t r = y0; r <= y1; r++, fbidx += dev->stride) {
+			for (coord_t i = 0; i < n; i += len) {
+				coord_t m = (n-i < len) ? n-i : len;
+				line(arg, tmp, x0-x+i, r-y, m);
+				if (dev->use_band) {
+					band_copy(dev, x0+i, r, m, tmp);
+					continue;
+				}
+				for (coord_t j = 0; j < m; j++) {
+					dev->frame_index[fbidx+i+j] = palette_index(dev, tmp[j]);
+				}
+			}
+		}
+		if (dev->use_frame_buffer) {
+			frame_damage(dev, x0+dev->orgx, y0+dev->orgy, x1+dev->orgx, y1+dev->orgy);
+		}
+	} else {
+		color_t *bufs[2];
+		uint8_t nbuf = 0;
+		for (uint8_t i = 0; i < 2; i++) {
+			bufs[nbuf] = line_buffer(dev, i);
+			if (bufs[nbuf] != NULL) nbuf++;
+		}
+		span_flush(dev);
+		if (nbuf == 0) { // pieces through the shared transfer buffer
+			spi_master_write_window(dev,
+				x0+dev->winx, y0+dev->winy,
+				x1+dev->winx, y1+dev->winy);
+			for (coord_t r = y0; r <= y1; r++) {
+				for (coord_t i = 0; i < n; i += LINE_PART) {
+					coord_t m = (n-i < LINE_PART) ? n-i : LINE_PART;
+					line(arg, part, x0-x+i, r-y, m);
+					spi_master_write_colors(dev, part, m);
+				}
+			}
+			return;
+		}
+		spi_master_queue_wait(dev); // line buffers free
+		spi_master_queue_window(dev,
+			x0+dev->winx, y0+dev->winy,
+			x1+dev->winx, y1+dev->winy);
+		for (coord_t r = y0, k = 0; r <= y1; r += LINE_GROUP, k++) {
+			coord_t m = (y1-r+1 < LINE_GROUP) ? y1-r+1 : LINE_GROUP;
+			color_t *buf = bufs[k % nbuf];
+			if (k >= nbuf) spi_master_queue_reclaim(dev, nbuf-1);
+			for (coord_t j = 0; j < m; j++) line(arg, buf+j*n, x0-x, r+j-y, n);
+			kern_copy16_swap(buf, buf, (size_t)n*m);
+			spi_master_queue_colors(dev, buf, (size_t)n*m);
+		}
 	}
 }
 
@@ -938,97 +2509,115 @@ void lcd_fillRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, color_t color
 	if (x0>x1) swap(coord_t, x0, x1);
 	if (y0>y1) swap(coord_t, y0, y1);
 
-	if (x1 < 0 || x0 >= dev->width) return; // off screen
-	if (y1 < 0 || y0 >= dev->height) return;
+	if (x1 < dev->clip.x0 || x0 > dev->clip.x1) return; // off screen
+	if (y1 < dev->clip.y0 || y0 > dev->clip.y1) return;
 
-	if (x0 < 0) x0 = 0; // clip
-	if (x1 >= dev->width) x1=dev->width-1;
-	if (y0 < 0) y0 = 0;
-	if (y1 >= dev->height) y1=dev->height-1;
+	if (x0 < dev->clip.x0) x0 = dev->clip.x0; // clip
+	if (x1 > dev->clip.x1) x1 = dev->clip.x1;
+	if (y0 < dev->clip.y0) y0 = dev->clip.y0;
+	if (y1 > dev->clip.y1) y1 = dev->clip.y1;
 
 	if (dev->use_frame_buffer) {
-		for (size_t j = y0; j <= y1; j++){
-			for (size_t i = x0; i <= x1; i++){
-				dev->frame_buffer[j*dev->width+i] = color;
-			}
-		}
+		frame_fill(dev, x0, y0, x1, y1, color);
+	} else if (dev->use_band) {
+		band_fill(dev, x0, y0, x1, y1, color);
+	} else if (dev->span_hold) {
+		span_add(dev, x0, y0, x1, y1, color);
 	} else {
-		coord_t _x0 = x0 + dev->offsetx;
-		coord_t _x1 = x1 + dev->offsetx;
-		coord_t _y0 = y0 + dev->offsety;
-		coord_t _y1 = y1 + dev->offsety;
+		coord_t _x0 = x0 + dev->winx;
+		coord_t _x1 = x1 + dev->winx;
+		coord_t _y0 = y0 + dev->winy;
+		coord_t _y1 = y1 + dev->winy;
 		size_t size = (size_t)(_x1-_x0+1)*(_y1-_y0+1);
 
-		spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-		spi_master_write_addr(dev, _x0, _x1);
-		spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-		spi_master_write_addr(dev, _y0, _y1);
-		spi_master_write_command(dev, 0x2C); // Memory Write
+		spi_master_write_window(dev, _x0, _y0, _x1, _y1);
 		spi_master_write_color(dev, color, size);
 	}
 }
 
 void lcd_drawRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
 {
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
+	if (x0>x1) swap(coord_t, x0, x1);
+	if (y0>y1) swap(coord_t, y0, y1);
+
+	if (x1-x0+1-(r<<1) < 1 || y1-y0+1-(r<<1) < 1) return;
+	circle_draw(dev, x0, y0, x1, y1, r, color);
+}
 
+void lcd_fillRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+{
 	if (x0>x1) swap(coord_t, x0, x1);
 	if (y0>y1) swap(coord_t, y0, y1);
 
-	coord_t w = x1-x0+1-(r<<1);
-	coord_t h = y1-y0+1-(r<<1);
-	if (w < 1 || h < 1) return;
+	if (x1-x0+1-(r<<1) < 1 || y1-y0+1-(r<<1) < 1) return;
+	circle_fill(dev, x0, y0, x1, y1, r, color);
+}
 
-	xa=0;
-	ya=-r;
-	err=2-2*r;
+//----------------------------------------------------------------------------//
+// Fixed-point trigonometry
+//----------------------------------------------------------------------------//
 
-	do {
-		if (xa) {
-			lcd_drawPixel(x0+r-xa, y0+r+ya, color);
-			lcd_drawPixel(x1-r+xa, y0+r+ya, color);
-			lcd_drawPixel(x0+r-xa, y1-r-ya, color);
-			lcd_drawPixel(x1-r+xa, y1-r-ya, color);
-		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_drawHLine(x0+r, y0,   w, color);
-	lcd_drawHLine(x0+r, y1,   w, color);
-	lcd_drawVLine(x0,   y0+r, h, color);
-	lcd_drawVLine(x1,   y0+r, h, color);
+// Sine of 0 to 90 degrees in Q15 (1.0 = 32768, saturated at 32767).
+static const int16_t sin_q15[91] = {
+	    0,   572,  1144,  1715,  2286,  2856,  3425,  3993,  4560,  5126,
+	 5690,  6252,  6813,  7371,  7927,  8481,  9032,  9580, 10126, 10668,
+	11207, 11743, 12275, 12803, 13328, 13848, 14365, 14876, 15384, 15886,
+	16384, 16877, 17364, 17847, 18324, 18795, 19261, 19720, 20174, 20622,
+	21063, 21498, 21926, 22348, 22763, 23170, 23571, 23965, 24351, 24730,
+	25102, 25466, 25822, 26170, 26510, 26842, 27166, 27482, 27789, 28088,
+	28378, 28660, 28932, 29197, 29452, 29698, 29935, 30163, 30382, 30592,
+	30792, 30983, 31164, 31336, 31499, 31651, 31795, 31928, 32052, 32166,
+	32270, 32365, 32449, 32524, 32588, 32643, 32688, 32723, 32748, 32763,
+	32767,
+};
+
+// Sine in Q15 of an angle in 1/256 degree. Between whole degrees the
+// table is interpolated linearly.
+static int32_t trig_sin8(int32_t a)
+{
+	int32_t sign = 1;
+	a %= 360*256;
+	if (a < 0) a += 360*256;
+	if (a >= 180*256) {a -= 180*256; sign = -1;}
+	if (a > 90*256) a = 180*256 - a;
+	int32_t i = a >> 8, f = a & 255;
+	int32_t v = sin_q15[i];
+	if (f) v += ((sin_q15[i+1] - v) * f) >> 8;
+	return sign * v;
 }
 
-void lcd_fillRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t r, color_t color)
+#define Q15_ROUND(v) (((v) + (1 << 14)) >> 15)
+
+// Rotate (x, y) by the angle with cosine c and sine s in Q15, in the same
+// direction as the primitives below, then offset by (xc, yc).
+inline static void trig_rotate(coord_t x, coord_t y, int32_t c, int32_t s, coord_t xc, coord_t yc, coord_t *xo, coord_t *yo)
 {
-	coord_t xa;
-	coord_t ya;
-	coord_t err;
-	coord_t old_err;
+	*xo = xc + Q15_ROUND(x*c + y*s);
+	*yo = yc + Q15_ROUND(y*c - x*s);
+}
 
-	if (x0>x1) swap(coord_t, x0, x1);
-	if (y0>y1) swap(coord_t, y0, y1);
+// Vertex i of a regular polygon of n sides and radius r, at angle
+// 360*i/n - angle around (xc, yc).
+inline static void trig_vertex(coord_t xc, coord_t yc, coord_t i, coord_t n, coord_t r, angle_t angle, coord_t *xo, coord_t *yo)
+{
+	int32_t a = i * (360*256) / n - (int32_t)angle*256;
+	*xo = xc + Q15_ROUND(r * trig_sin8(90*256 - a));
+	*yo = yc + Q15_ROUND(r * trig_sin8(a));
+}
 
-	coord_t w1 = x1-x0+1-(r<<1);
-	coord_t h1 = y1-y0+1-(r<<1);
-	if (w1 < 1 || h1 < 1) return;
+int16_t lcd_sinQ15(angle_t angle)
+{
+	return trig_sin8((int32_t)angle*256);
+}
 
-	xa=0;
-	ya=-r;
-	err=2-2*r;
+int16_t lcd_cosQ15(angle_t angle)
+{
+	return trig_sin8((90-(int32_t)angle)*256);
+}
 
-	do {
-		if (xa) {
-			lcd_drawHLine(x0+r-xa, y0+r+ya, w1+(xa<<1), color);
-			lcd_drawHLine(x0+r-xa, y1-r-ya, w1+(xa<<1), color);
-		}
-		if ((old_err=err)<=xa)    err+=++xa*2+1;
-		if (old_err>ya || err>xa) err+=++ya*2+1;
-	} while (ya<0);
-	lcd_fillRect(x0, y0+r, x1-x0+1, h1, color);
+void lcd_rotatePoint(coord_t x, coord_t y, coord_t xc, coord_t yc, angle_t angle, coord_t *xr, coord_t *yr)
+{
+	trig_rotate(x, y, lcd_cosQ15(angle), lcd_sinQ15(angle), xc, yc, xr, yr);
 }
 
 //----------------------------------------------------------------------------//
@@ -1038,34 +2627,22 @@ void lcd_fillRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t
 /**
  * @details A vertex's final position is calculated by rotating it
  *  around the center point of the primitive by the angle specified.
- * x1 = x * cos(angle) - y * sin(angle) + xc
- * y1 = x * sin(angle) + y * cos(angle) + yc
+ * x1 = x * cos(angle) + y * sin(angle) + xc
+ * y1 = y * cos(angle) - x * sin(angle) + yc
+ *  The sine and cosine come from a Q15 table, once per primitive.
  */
 void lcd_drawRectC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle, color_t color)
 {
-	float xd, yd, rd;
+	int32_t c = lcd_cosQ15(angle), s = lcd_sinQ15(angle);
 	coord_t x1, y1;
 	coord_t x2, y2;
 	coord_t x3, y3;
 	coord_t x4, y4;
-	rd = -angle * M_PIf / 180.0f; // degrees to radians
-	xd = 0.0f - w/2;
-	yd = h/2;
-	x1 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y1 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
 
-	yd = 0.0f - yd;
-	x2 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y2 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	xd = w/2;
-	yd = h/2;
-	x3 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y3 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	yd = 0.0f - yd;
-	x4 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y4 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	trig_rotate(-(w/2),  h/2,  c, s, xc, yc, &x1, &y1);
+	trig_rotate(-(w/2), -(h/2), c, s, xc, yc, &x2, &y2);
+	trig_rotate(  w/2,   h/2,  c, s, xc, yc, &x3, &y3);
+	trig_rotate(  w/2, -(h/2), c, s, xc, yc, &x4, &y4);
 
 	lcd_drawLine(x1, y1, x2, y2, color);
 	lcd_drawLine(x1, y1, x3, y3, color);
@@ -1076,29 +2653,20 @@ void lcd_drawRectC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle,
 /**
  * @details A vertex's final position is calculated by rotating it
  *  around the center point of the primitive by the angle specified.
- * x1 = x * cos(angle) - y * sin(angle) + xc
- * y1 = x * sin(angle) + y * cos(angle) + yc
+ * x1 = x * cos(angle) + y * sin(angle) + xc
+ * y1 = y * cos(angle) - x * sin(angle) + yc
+ *  The sine and cosine come from a Q15 table, once per primitive.
  */
 void lcd_drawTriangleC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t angle, color_t color)
 {
-	float xd, yd, rd;
+	int32_t c = lcd_cosQ15(angle), s = lcd_sinQ15(angle);
 	coord_t x1, y1;
 	coord_t x2, y2;
 	coord_t x3, y3;
-	rd = -angle * M_PIf / 180.0f; // degrees to radians
-	xd = 0.0f;
-	yd = h/2;
-	x1 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y1 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
 
-	xd = w/2;
-	yd = 0.0f - yd;
-	x2 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y2 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-	xd = 0.0f - w/2;
-	x3 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-	y3 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	trig_rotate(     0,   h/2,  c, s, xc, yc, &x1, &y1);
+	trig_rotate(  w/2, -(h/2), c, s, xc, yc, &x2, &y2);
+	trig_rotate(-(w/2), -(h/2), c, s, xc, yc, &x3, &y3);
 
 	lcd_drawLine(x1, y1, x2, y2, color);
 	lcd_drawLine(x1, y1, x3, y3, color);
@@ -1106,92 +2674,110 @@ void lcd_drawTriangleC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t ang
 }
 
 /**
- * @details A vertex's final position is calculated by rotating it
- *  around the center point of the primitive by the angle specified.
- * x1 = x * cos(angle) - y * sin(angle) + xc
- * y1 = x * sin(angle) + y * cos(angle) + yc
+ * @details Vertex i is at angle 360*i/n - angle on a circle of radius r
+ *  around the center point, which is the vertex of an unrotated polygon
+ *  rotated by the angle specified. Each vertex takes one lookup in the
+ *  interpolated Q15 table.
  */
 void lcd_drawRegularPolygonC(coord_t xc, coord_t yc, coord_t n, coord_t r, angle_t angle, color_t color)
 {
-	float xd, yd, rd;
 	coord_t x1, y1;
 	coord_t x2, y2;
 	coord_t i;
 
-	rd = -angle * M_PIf / 180.0f; // degrees to radians
-	for (i = 0; i < n; i++) {
-		xd = r * cosf(2 * M_PIf * i / n);
-		yd = r * sinf(2 * M_PIf * i / n);
-		x1 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-		y1 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
-
-		xd = r * cosf(2 * M_PIf * (i + 1) / n);
-		yd = r * sinf(2 * M_PIf * (i + 1) / n);
-		x2 = (coord_t)(xd * cosf(rd) - yd * sinf(rd) + xc);
-		y2 = (coord_t)(xd * sinf(rd) + yd * cosf(rd) + yc);
+	if (n < 1) return;
+	for (i = 0; i <= n; i++) {
+		trig_vertex(xc, yc, i % n, n, r, angle, &x2, &y2);
+		if (i) lcd_drawLine(x1, y1, x2, y2, color);
+		x1 = x2; y1 = y2;
+	}
+}
 
-		lcd_drawLine(x1, y1, x2, y2, color);
+/**
+ * @details Vertices are placed as in lcd_drawRegularPolygonC() and
+ *  filled in one scanline pass by lcd_fillPolygon().
+ */
+void lcd_fillRegularPolygonC(coord_t xc, coord_t yc, coord_t n, coord_t r, angle_t angle, color_t color)
+{
+	coord_t xy_stack[2*POLY_STACK];
+	coord_t *xy = xy_stack;
+
+	if (n < 3) return;
+	if (n > POLY_STACK) {
+		xy = malloc(2*n*sizeof(coord_t));
+		if (xy == NULL) {
+			ESP_LOGE(TAG, "polygon vertex alloc fail");
+			return;
+		}
 	}
+	for (coord_t i = 0; i < n; i++) {
+		trig_vertex(xc, yc, i, n, r, angle, &xy[2*i], &xy[2*i+1]);
+	}
+	poly_fill(dev, xy, n, FILL_EVEN_ODD, color); // convex, either rule
+	if (xy != xy_stack) free(xy);
 }
 
 //----------------------------------------------------------------------------//
 // Draw characters and strings
 //----------------------------------------------------------------------------//
 
+/**
+ * @details With a font background, the character is drawn as one window
+ *  from its glyph cell. Without one, each run of set pixels in a font
+ *  column is drawn as one rectangle. Either way the rotation is applied
+ *  to whole cells or runs, not to each pixel.
+ */
 coord_t lcd_drawChar(coord_t x, coord_t y, char ascii, color_t color)
 {
-#if 0
-	if ((x >= dev->width) ||                        // off screen right
-		(y >= dev->height) ||                       // off screen bottom
-		((x + LCD_CHAR_W * dev->font_size) <= 0) || // off screen left
-		((y + LCD_CHAR_H * dev->font_size) <= 0))   // off screen top
-		return;
-#endif
-
-	if (dev->font_back_en) {
-		lcd_fillRect(x, y,
-			LCD_CHAR_W*dev->font_size,
-			LCD_CHAR_H*dev->font_size,
-			dev->font_back_color);
-	}
-	for (int8_t i = 0; i < LCD_CHAR_W; i++) {
-		uint8_t line;
-		if (i == LCD_CHAR_W-1)
-			line = 0x0;
-		else
-			line = font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i];
-		for (int8_t j = 0; j < LCD_CHAR_H; j++) {
-			if (line & 0x1) {
-				if (dev->font_size == 1) // default size
-					lcd_drawPixel(x + i, y + j, color);
-				else { // big size
-					coord_t x1 = x + (i * dev->font_size), y1 = y + (j * dev->font_size);
-					lcd_fillRect(x1, y1, dev->font_size, dev->font_size, color);
-				}
+	if (dev->font_back_en) return text_draw(dev, x, y, &ascii, 1, color);
+
+	rect_t b;
+	coord_t s = dev->font_size;
+	coord_t next = text_box(dev, x, y, 1, &b);
+	if ((b.x0 > dev->clip.x1) || // off screen right
+		(b.y0 > dev->clip.y1) || // off screen bottom
+		(b.x1 < dev->clip.x0) || // off screen left
+		(b.y1 < dev->clip.y0))   // off screen top
+		return next;
+
+	span_hold(dev);
+	for (int8_t i = 0; i < LCD_CHAR_W-1; i++) {
+		uint8_t line = font[((uint8_t)ascii * (LCD_CHAR_W-1)) + i];
+		for (int8_t j = 0; line; ) {
+			if (!(line & 0x1)) {line >>= 1; j++; continue;}
+			int8_t j0 = j;
+			while (line & 0x1) {line >>= 1; j++;}
+			coord_t gx = i*s, gy = j0*s, gh = (j-j0)*s; // run in the character
+			switch (dev->font_direction) {
+			default:
+			case DIRECTION0:   lcd_fillRect(x+gx, y+gy, s, gh, color); break;
+			case DIRECTION90:  lcd_fillRect(x-gy-gh+1, y+gx, gh, s, color); break;
+			case DIRECTION180: lcd_fillRect(x-gx-s+1, y-gy-gh+1, s, gh, color); break;
+			case DIRECTION270: lcd_fillRect(x+gy, y-gx-s+1, gh, s, color); break;
 			}
-#if 0
-			else if (dev->font_back_en) {
-				if (dev->font_size == 1) // default size
-					lcd_drawPixel(x + i, y + j, dev->font_back_color);
-				else { // big size
-					coord_t x1 = x + (i * dev->font_size), y1 = y + (j * dev->font_size);
-					lcd_fillRect(x1, y1, dev->font_size, dev->font_size, dev->font_back_color);
-				}
-			}
-#endif
-			line >>= 1;
 		}
 	}
-	return x+LCD_CHAR_W*dev->font_size;
+	span_release(dev);
+	return next;
 }
 
+/**
+ * @details With a font background, the whole string is drawn as one
+ *  window, assembled a row at a time from cached glyph cells.
+ */
 coord_t lcd_drawString(coord_t x, coord_t y, const char *ascii, color_t color)
 {
 	size_t length = strlen(ascii);
+	if (dev->font_back_en) return text_draw(dev, x, y, ascii, length, color);
+
+	bool vertical = TEXT_VERTICAL(dev->font_direction);
+	span_hold(dev);
 	for (size_t i=0; i<length; i++) {
-		x = lcd_drawChar(x, y, ascii[i], color);
+		if (vertical) y = lcd_drawChar(x, y, ascii[i], color);
+		else x = lcd_drawChar(x, y, ascii[i], color);
 	}
-	return x;
+	span_release(dev);
+	return vertical ? y : x;
 }
 
 //----------------------------------------------------------------------------//
@@ -1200,7 +2786,6 @@ coord_t lcd_drawString(coord_t x, coord_t y, const char *ascii, color_t color)
 
 void lcd_setFontDirection(direction_t dir)
 {
-	// TODO: implement, currently direction always 0
 	dev->font_direction = dir;
 }
 
@@ -1265,114 +2850,525 @@ void lcd_inversionOn(void)
 	spi_master_write_command(dev, 0x21); // Display Inversion ON (21h), INVON (21h): Display Inversion On
 }
 
+void lcd_scrollArea(coord_t top, coord_t height)
+{
+	static uint8_t Byte[6];
+
+	if (top < 0) {height += top; top = 0;} // clip
+	if (top+height > dev->height) height = dev->height-top;
+	if (height <= 0) { // leave scroll mode
+		spi_master_write_command(dev, 0x13); // Normal Display Mode ON (13h), NORON (13h): Normal Display Mode On
+		dev->scroll_top = 0;
+		dev->scroll_height = 0;
+		return;
+	}
+
+	if (top + dev->offsety + height > LCD_GATE_LINES) {
+		ESP_LOGW(TAG, "scroll area %d+%d beyond %d gate lines", (int)(top + dev->offsety), (int)height, LCD_GATE_LINES);
+		return;
+	}
+	uint16_t tfa = top + dev->offsety;
+	uint16_t bfa = LCD_GATE_LINES - tfa - height;
+	Byte[0] = (tfa >> 8) & 0xFF;
+	Byte[1] = tfa & 0xFF;
+	Byte[2] = (height >> 8) & 0xFF;
+	Byte[3] = height & 0xFF;
+	Byte[4] = (bfa >> 8) & 0xFF;
+	Byte[5] = bfa & 0xFF;
+	spi_master_write_command(dev, 0x33); // Vertical Scrolling Definition (33h), VSCRDEF (33h): Vertical Scrolling Definition
+	spi_master_write_bytes(dev, Byte, 6, SPI_Data_Mode);
+	dev->scroll_top = top;
+	dev->scroll_height = height;
+	lcd_scrollTo(0);
+}
+
+void lcd_scrollTo(coord_t line)
+{
+	static uint8_t Byte[2];
+
+	if (dev->scroll_height == 0) return;
+	line %= dev->scroll_height;
+	if (line < 0) line += dev->scroll_height;
+
+	uint16_t vsp = dev->scroll_top + dev->offsety + line;
+	Byte[0] = (vsp >> 8) & 0xFF;
+	Byte[1] = vsp & 0xFF;
+	spi_master_write_command(dev, 0x37); // Vertical Scrolling Start Address (37h), VSCRSADD (37h): Vertical Scroll Start Address of RAM
+	spi_master_write_bytes(dev, Byte, 2, SPI_Data_Mode);
+}
+
 //----------------------------------------------------------------------------//
 // Frame management
 //----------------------------------------------------------------------------//
 
 void lcd_frameEnable(void)
 {
-	if (dev->use_frame_buffer == true) return;
+	if (dev->use_frame_buffer || dev->use_band) return;
 	dev->frame_buffer = heap_caps_malloc(sizeof(color_t)*dev->width*dev->height, MALLOC_CAP_DMA);
 	if (dev->frame_buffer == NULL) {
 		ESP_LOGE(TAG, "frame buffer alloc fail");
 	} else {
 		ESP_LOGI(TAG, "frame buffer alloc success");
 		dev->use_frame_buffer = true;
+		frame_damage_all(dev);
+	}
+}
+
+/**
+ * @details Two strips of BAND_LINES rows are allocated from DMA-capable
+ *  memory, about 20 KB in total instead of 150 KB for a frame buffer.
+ */
+void lcd_bandEnable(uint32_t list_size)
+{
+	if (dev->use_frame_buffer || dev->use_band) return;
+	size_t strip = sizeof(color_t)*dev->width*BAND_LINES;
+	dev->band_buf[0] = heap_caps_malloc(strip, MALLOC_CAP_DMA);
+	dev->band_buf[1] = heap_caps_malloc(strip, MALLOC_CAP_DMA);
+	dev->band_list = heap_caps_malloc(list_size, MALLOC_CAP_8BIT);
+	if (dev->band_buf[0] == NULL || dev->band_buf[1] == NULL || dev->band_list == NULL) {
+		ESP_LOGE(TAG, "band alloc fail");
+		lcd_bandDisable();
+	} else {
+		ESP_LOGI(TAG, "band alloc success");
+		dev->use_band = true;
+		dev->band_size = list_size/sizeof(uint16_t);
+		dev->band_drop = 0;
+		band_clear(dev, BLACK);
+	}
+}
+
+void lcd_bandDisable(void)
+{
+	spi_master_queue_wait(dev);
+	for (uint8_t i = 0; i < 2; i++) {
+		if (dev->band_buf[i] != NULL) heap_caps_free(dev->band_buf[i]);
+		dev->band_buf[i] = NULL;
+	}
+	if (dev->band_list != NULL) heap_caps_free(dev->band_list);
+	dev->band_list = NULL;
+	dev->use_band = false;
+}
+
+/**
+ * @details Palette entries are assigned to colors as they are first drawn.
+ */
+void lcd_frameEnableIndexed(void)
+{
+	if (dev->use_frame_buffer || dev->use_band) return;
+	dev->frame_index = heap_caps_malloc((size_t)dev->width*dev->height, MALLOC_CAP_8BIT);
+	if (dev->frame_index == NULL) {
+		ESP_LOGE(TAG, "indexed frame buffer alloc fail");
+	} else {
+		ESP_LOGI(TAG, "indexed frame buffer alloc success");
+		dev->use_frame_buffer = true;
+		dev->pal_cnt = 0;
+		memset(dev->frame_index, palette_index(dev, BLACK), (size_t)dev->width*dev->height);
+		frame_damage_all(dev);
 	}
 }
 
+uint8_t lcd_paletteIndex(color_t color)
+{
+	return palette_index(dev, color);
+}
+
+void lcd_paletteSet(uint8_t index, color_t color)
+{
+	dev->pal_out[index] = SWAP16(color);
+	if (dev->frame_index != NULL) frame_damage_all(dev);
+}
+
 void lcd_frameDisable(void)
 {
+	spi_master_queue_wait(dev);
+	if (dev->frame_index != NULL) heap_caps_free(dev->frame_index);
+	dev->frame_index = NULL;
+	for (uint8_t i = 0; i < 2; i++) {
+		if (dev->front_buf[i] != NULL) heap_caps_free(dev->front_buf[i]);
+		dev->front_buf[i] = NULL;
+	}
+	dev->front_fail = false;
 	if (dev->frame_buffer != NULL) heap_caps_free(dev->frame_buffer);
 	dev->frame_buffer = NULL;
 	dev->use_frame_buffer = false;
 }
 
+/**
+ * @details The caller may write to the frame buffer directly, so the
+ *  whole frame is marked as changed.
+ */
 color_t *lcd_getFrameBuffer(void)
 {
+	if (dev->use_frame_buffer) frame_damage_all(dev);
 	return dev->frame_buffer;
 }
 
-void lcd_wrapAround(scroll_t scroll, coord_t start, coord_t end)
+/**
+ * @details The setting belongs to the screen, so a canvas target is set
+ *  aside while the screen frame buffer is converted.
+ */
+void lcd_frameSwapped(bool swapped)
+{
+	const canvas_t *c = dev->canvas;
+	lcd_setCanvas(NULL);
+	if (dev->frame_swap != swapped) {
+		spi_master_queue_wait(dev);
+		dev->frame_swap = swapped;
+		if (dev->frame_buffer != NULL) { // indexed expands in panel order
+			size_t len = (size_t)dev->stride*dev->height;
+			kern_copy16_swap(dev->frame_buffer, dev->frame_buffer, len);
+		}
+	}
+	lcd_setCanvas(c);
+}
+
+void lcd_frameDamage(coord_t x, coord_t y, coord_t w, coord_t h)
+{
+	coord_t x1 = x+w-1;
+	coord_t y1 = y+h-1;
+
+	if (dev->use_frame_buffer == false) return;
+	if (x1 < 0 || x >= dev->width) return; // off screen
+	if (y1 < 0 || y >= dev->height) return;
+
+	if (x < 0) x = 0; // clip
+	if (x1 >= dev->width) x1=dev->width-1;
+	if (y < 0) y = 0;
+	if (y1 >= dev->height) y1=dev->height-1;
+
+	frame_damage(dev, x, y, x1, y1);
+}
+
+void lcd_frameDamageMode(damage_t mode)
+{
+	dev->damage_mode = mode;
+	frame_damage_clear(dev);
+	frame_damage_all(dev);
+}
+
+void lcd_getFrameStats(frame_stats_t *stats)
+{
+	*stats = dev->stats;
+}
+
+// Rotate the rows of a frame buffer band down by n, where a band row is
+// len bytes at the same offset in each of h rows that are stride bytes
+// apart. Rows move one at a time along cycles of the rotation, so only
+// one row is held in wk.
+static void frame_wrap_rows(uint8_t *band, size_t stride, size_t len, size_t h, size_t n, uint8_t *wk)
+{
+	size_t cycles = h, r = n;
+	while (r) {size_t t = cycles % r; cycles = r; r = t;} // gcd(h, n)
+
+	for (size_t s = 0; s < cycles; s++) {
+		size_t j = s;
+		memcpy(wk, band + j*stride, len);
+		for (;;) {
+			size_t src = (j + h - n) % h;
+			if (src == s) break;
+			memcpy(band + j*stride, band + src*stride, len);
+			j = src;
+		}
+		memcpy(band + j*stride, wk, len);
+	}
+}
+
+void lcd_wrapAroundN(scroll_t scroll, coord_t start, coord_t end, coord_t n)
 {
 	if (dev->use_frame_buffer == false) return;
 
-	coord_t fb_w = dev->width;
-	coord_t fb_h = dev->height;
-	size_t index1;
-	size_t index2;
+	size_t fb_w = dev->width; // current target, screen or canvas
+	size_t fb_h = dev->height;
+	size_t fb_s = dev->stride;
+	size_t ps; // bytes per pixel
+	uint8_t *fb;
+
+	if (scroll == SCROLL_RIGHT || scroll == SCROLL_LEFT)
+		frame_damage(dev, 0, start, fb_w-1, end);
+	else
+		frame_damage(dev, start, 0, end, fb_h-1);
+
+	if (dev->frame_index != NULL) {
+		fb = dev->frame_index;
+		ps = sizeof(uint8_t);
+	} else {
+		fb = (uint8_t *)dev->frame_buffer;
+		ps = sizeof(color_t);
+	}
 
+	// Scroll right and down by an amount in [0, size).
+	coord_t size = (scroll == SCROLL_RIGHT || scroll == SCROLL_LEFT) ? fb_w : fb_h;
+	n %= size;
+	if (n < 0) n += size;
+	if (scroll == SCROLL_LEFT || scroll == SCROLL_UP) n = (size - n) % size;
+	if (n == 0) return;
+
+	uint8_t wk[fb_w*ps];
 	switch (scroll) {
-	case SCROLL_RIGHT: {
-		color_t wk[fb_w];
-		for (size_t i=start;i<=end;i++) {
-			index1 = i * fb_w;
-			memcpy((char *)wk, (char*)&dev->frame_buffer[index1], fb_w*sizeof(color_t));
-			index2 = index1 + fb_w - 1;
-			dev->frame_buffer[index1] = dev->frame_buffer[index2];
-			memcpy((char *)&dev->frame_buffer[index1+1], (char *)&wk[0], (fb_w-1)*sizeof(color_t));
+	case SCROLL_RIGHT:
+	case SCROLL_LEFT:
+		for (coord_t i=start;i<=end;i++) {
+			uint8_t *row = fb + i*fb_s*ps;
+			memcpy(wk, row, fb_w*ps);
+			memcpy(row, wk + (fb_w-n)*ps, n*ps);
+			memcpy(row + n*ps, wk, (fb_w-n)*ps);
 		}
-		break; }
-	case SCROLL_LEFT: {
-		color_t wk[fb_w];
-		for (size_t i=start;i<=end;i++) {
-			index1 = i * fb_w;
-			memcpy((char *)wk, (char*)&dev->frame_buffer[index1], fb_w*sizeof(color_t));
-			index2 = index1 + fb_w - 1;
-			dev->frame_buffer[index2] = dev->frame_buffer[index1];
-			memcpy((char *)&dev->frame_buffer[index1], (char *)&wk[1], (fb_w-1)*sizeof(color_t));
+		break;
+	case SCROLL_DOWN:
+	case SCROLL_UP:
+		frame_wrap_rows(fb + start*ps, fb_s*ps, (end-start+1)*ps, fb_h, n, wk);
+		break;
+	}
+}
+
+/**
+ * @details Rows are moved as whole segments by lcd_wrapAroundN().
+ */
+void lcd_wrapAround(scroll_t scroll, coord_t start, coord_t end)
+{
+	lcd_wrapAroundN(scroll, start, end, 1);
+}
+
+void lcd_writeFrame(void)
+{
+	if (dev->use_band) {
+		band_write(dev, true);
+		return;
+	}
+	if (dev->use_frame_buffer == false) return;
+
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	rect_t r;
+	frame_region_start(dev);
+	while (frame_region_next(dev, &r)) {
+		spi_master_write_window(dev,
+			r.x0+dev->offsetx, r.y0+dev->offsety,
+			r.x1+dev->offsetx, r.y1+dev->offsety);
+		size_t offset = (size_t)r.y0*dev->width + r.x0;
+		if (dev->frame_index != NULL) {
+			spi_master_write_index(dev, dev->frame_index + offset, dev->width,
+				r.x1-r.x0+1, r.y1-r.y0+1, dev->pal_out);
+		} else if (dev->frame_swap && r.x0 == 0 && r.x1 == dev->width-1) {
+			// contiguous rows in panel byte order, DMA with no copy
+			spi_master_queue_colors(dev, dev->frame_buffer + offset, (size_t)dev->width*(r.y1-r.y0+1));
+		} else {
+			spi_master_write_rect(dev, dev->frame_buffer + offset, dev->width,
+				r.x1-r.x0+1, r.y1-r.y0+1, dev->frame_swap);
 		}
-		break; }
-	case SCROLL_DOWN: {
-		color_t wk;
-		for (size_t i=start;i<=end;i++) {
-			index2 = (size_t)(fb_h-1) * fb_w + i;
-			wk = dev->frame_buffer[index2];
-			for (ssize_t j=fb_h-2;j>=0;j--) {
-				index1 = j * fb_w + i;
-				index2 = (j+1) * fb_w + i;
-				dev->frame_buffer[index2] = dev->frame_buffer[index1];
+		dev->stats.regions++;
+	}
+	spi_master_queue_wait(dev);
+	frame_damage_clear(dev);
+	return;
+}
+
+/**
+ * @details Each changed region is copied in panel byte order into one of
+ *  two strips of XFER_MAX bytes, allocated on first use, and each strip is
+ *  queued as one transaction. A strip is filled while the other is sent,
+ *  so the copy overlaps the transfer, and the call returns with the last
+ *  strips still in flight. If the strips cannot be allocated, fall back to
+ *  lcd_writeFrame().
+ */
+void lcd_writeFrameAsync(void)
+{
+	if (dev->use_band) {
+		band_write(dev, false);
+		return;
+	}
+	if (dev->use_frame_buffer == false) return;
+	if (dev->frame_index != NULL) { // strips would only add a copy
+		lcd_writeFrame();
+		return;
+	}
+
+	if (dev->front_buf[0] == NULL && !dev->front_fail) {
+		dev->front_buf[0] = heap_caps_malloc(XFER_MAX, MALLOC_CAP_DMA);
+		dev->front_buf[1] = heap_caps_malloc(XFER_MAX, MALLOC_CAP_DMA);
+		if (dev->front_buf[0] == NULL || dev->front_buf[1] == NULL) {
+			ESP_LOGW(TAG, "front strip alloc fail, writing synchronously");
+			for (uint8_t i = 0; i < 2; i++) {
+				if (dev->front_buf[i] != NULL) heap_caps_free(dev->front_buf[i]);
+				dev->front_buf[i] = NULL;
 			}
-			dev->frame_buffer[i] = wk;
+			dev->front_fail = true;
 		}
-		break; }
-	case SCROLL_UP: {
-		color_t wk;
-		for (size_t i=start;i<=end;i++) {
-			wk = dev->frame_buffer[i];
-			for (size_t j=0;j<fb_h-1;j++) {
-				index1 = j * fb_w + i;
-				index2 = (j+1) * fb_w + i;
-				dev->frame_buffer[index1] = dev->frame_buffer[index2];
+	}
+	if (dev->front_buf[0] == NULL) {
+		lcd_writeFrame();
+		return;
+	}
+
+	spi_master_queue_wait(dev); // previous frame done with the strips
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	rect_t r;
+	uint32_t k = 0; // strips queued
+	frame_region_start(dev);
+	while (frame_region_next(dev, &r)) {
+		coord_t w = r.x1-r.x0+1;
+		if (w <= 0 || r.y1 < r.y0) continue; // from a zero-size draw
+		coord_t rows = XFER_MAX/sizeof(color_t)/w; // rows per strip
+		const color_t *src = dev->frame_buffer + (size_t)r.y0*dev->width + r.x0;
+		spi_master_queue_window(dev,
+			r.x0+dev->offsetx, r.y0+dev->offsety,
+			r.x1+dev->offsetx, r.y1+dev->offsety);
+		for (coord_t y = r.y0; y <= r.y1; y += rows, k++) {
+			coord_t n = (r.y1-y+1 < rows) ? r.y1-y+1 : rows;
+			color_t *strip = dev->front_buf[k&1], *dst = strip;
+			if (k >= 2) spi_master_queue_reclaim(dev, 1); // strip k-2 sent
+			for (coord_t j = 0; j < n; j++, src += dev->width, dst += w) {
+				if (dev->frame_swap) kern_copy16(dst, src, w);
+				else kern_copy16_swap(dst, src, w);
 			}
-			index2 = (size_t)(fb_h-1) * fb_w + i;
-			dev->frame_buffer[index2] = wk;
+			spi_master_queue_colors(dev, strip, (size_t)w*n);
 		}
-		break; }
+		dev->stats.regions++;
 	}
+	frame_damage_clear(dev);
 }
 
-void lcd_writeFrame(void)
+void lcd_waitFrame(void)
 {
-	if (dev->use_frame_buffer == false) return;
+	span_flush(dev);
+	spi_master_queue_wait(dev);
+}
 
-	spi_master_write_command(dev, 0x2A); // Column(x) Address Set
-	spi_master_write_addr(dev, dev->offsetx, dev->offsetx+dev->width-1);
-	spi_master_write_command(dev, 0x2B); // Page(y) Address Set
-	spi_master_write_addr(dev, dev->offsety, dev->offsety+dev->height-1);
-	spi_master_write_command(dev, 0x2C); // Memory Write
-	spi_master_write_colors(dev, dev->frame_buffer, dev->width*dev->height);
+void lcd_flush(void)
+{
+	span_flush(dev);
+}
 
-#if 0
-	size_t size = (size_t)dev->width*dev->height;
-	color_t *image = dev->frame_buffer;
-	while (size > 0) {
-		// 1024 bytes per time.
-		size_t bs = (size > 512) ? 512 : size;
-		spi_master_write_colors(dev, image, bs);
-		size -= bs;
-		image += bs;
+//----------------------------------------------------------------------------//
+// Clip rectangle and origin
+//----------------------------------------------------------------------------//
+
+void lcd_setClip(coord_t x, coord_t y, coord_t w, coord_t h)
+{
+	rect_t *v = &dev->view;
+	v->x0 = (x < 0) ? 0 : x; // clip to the target
+	v->y0 = (y < 0) ? 0 : y;
+	v->x1 = (x+w > dev->width) ? dev->width-1 : x+w-1;
+	v->y1 = (y+h > dev->height) ? dev->height-1 : y+h-1;
+	clip_update(dev);
+}
+
+void lcd_resetClip(void)
+{
+	dev->view = (rect_t){0, 0, dev->width-1, dev->height-1};
+	clip_update(dev);
+}
+
+void lcd_setOrigin(coord_t x, coord_t y)
+{
+	span_flush(dev); // pending spans use the old origin
+	dev->orgx = x;
+	dev->orgy = y;
+	clip_update(dev);
+}
+
+//----------------------------------------------------------------------------//
+// Offscreen canvases
+//----------------------------------------------------------------------------//
+
+// Save the drawing target state.
+static void target_save(TFT_t *dev, target_t *t)
+{
+	t->width = dev->width;
+	t->height = dev->height;
+	t->stride = dev->stride;
+	t->use_frame_buffer = dev->use_frame_buffer;
+	t->use_band = dev->use_band;
+	t->frame_swap = dev->frame_swap;
+	t->frame_buffer = dev->frame_buffer;
+	t->frame_index = dev->frame_index;
+	t->damage_mode = dev->damage_mode;
+	t->view = dev->view;
+	t->orgx = dev->orgx;
+	t->orgy = dev->orgy;
+}
+
+// Make a saved state the drawing target.
+static void target_load(TFT_t *dev, const target_t *t)
+{
+	dev->width = t->width;
+	dev->height = t->height;
+	dev->stride = t->stride;
+	dev->use_frame_buffer = t->use_frame_buffer;
+	dev->use_band = t->use_band;
+	dev->frame_swap = t->frame_swap;
+	dev->frame_buffer = t->frame_buffer;
+	dev->frame_index = t->frame_index;
+	dev->damage_mode = t->damage_mode;
+	dev->view = t->view;
+	dev->orgx = t->orgx;
+	dev->orgy = t->orgy;
+	clip_update(dev);
+}
+
+/**
+ * @details A canvas target looks like a plain RGB565 frame buffer with the
+ *  canvas stride and no damage tracking, so every primitive takes its frame
+ *  buffer path. The screen state is saved in dev->screen when the first
+ *  canvas is selected and loaded again by lcd_setCanvas(NULL).
+ */
+void lcd_setCanvas(const canvas_t *c)
+{
+	if (c == dev->canvas) return;
+	if (dev->canvas == NULL) {
+		span_flush(dev); // pending direct mode writes go to the screen
+		target_save(dev, &dev->screen);
 	}
-#endif
-	return;
+	dev->canvas = c;
+	if (c == NULL) {
+		target_load(dev, &dev->screen);
+		return;
+	}
+	target_t t = {
+		.width = c->width,
+		.height = c->height,
+		.stride = c->stride,
+		.use_frame_buffer = true,
+		.use_band = false,
+		.frame_swap = false,
+		.frame_buffer = c->pixels,
+		.frame_index = NULL,
+		.damage_mode = DAMAGE_NONE,
+		.view = {0, 0, c->width-1, c->height-1},
+	};
+	target_load(dev, &t);
+}
+
+const canvas_t *lcd_getCanvas(void)
+{
+	return dev->canvas;
+}
+
+bool lcd_subCanvas(canvas_t *sub, const canvas_t *c, coord_t x, coord_t y, coord_t w, coord_t h)
+{
+	if (x < 0) {w += x; x = 0;} // clip
+	if (y < 0) {h += y; y = 0;}
+	if (x+w > c->width) w = c->width-x;
+	if (y+h > c->height) h = c->height-y;
+	if (w <= 0 || h <= 0) return false;
+
+	sub->pixels = c->pixels + (size_t)y*c->stride + x;
+	sub->width = w;
+	sub->height = h;
+	sub->stride = c->stride;
+	return true;
+}
+
+/**
+ * @details The canvas is drawn like an image with rows stride elements
+ *  apart, so blits to the screen take the same path as
+ *  lcd_drawRGBBitmap() in each mode, and a canvas to canvas blit is one
+ *  row copy per row. The current target is left as it was.
+ */
+void lcd_blitCanvas(const canvas_t *src, const canvas_t *dst, coord_t x, coord_t y)
+{
+	const canvas_t *cur = dev->canvas;
+
+	lcd_setCanvas(dst);
+	draw_image(dev, x, y, src->pixels, src->stride, src->width, src->height);
+	lcd_setCanvas(cur);
 }
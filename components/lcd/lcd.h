@@ -17,6 +17,9 @@
 /** @name Use to create a custom color. */
 #define rgb565(r, g, b) ((((r) & 0xF8) << 8) | (((g) & 0xFC) << 3) | (((b) & 0xF8) >> 3))
 
+/** @name Convert a color to or from panel byte order. */
+#define swap565(c) ((color_t)(((c) << 8) | ((c) >> 8)))
+
 /** @name Standard colors. */
 /** @{ */
 
@@ -74,6 +77,48 @@ typedef enum {
 	SCROLL_UP = 4,
 } scroll_t;
 
+/** @brief Change tracking used to limit what a frame write sends. */
+typedef enum {
+	DAMAGE_NONE, ///< Always send the whole frame.
+	DAMAGE_RECT, ///< Send a short list of merged bounding boxes (default).
+	DAMAGE_TILE, ///< Send runs of changed 16x16 tiles.
+} damage_t;
+
+/** @brief Rule deciding which parts of a self-intersecting polygon are inside. */
+typedef enum {
+	FILL_EVEN_ODD, ///< Inside if a ray from the point crosses an odd number of edges.
+	FILL_NONZERO,  ///< Inside if the edges wind around the point a nonzero number of times.
+} fill_rule_t;
+
+/** @brief Statistics for the last frame write. */
+typedef struct {
+	uint32_t bytes;   ///< Bytes sent over SPI, including window setup.
+	uint32_t trans;   ///< SPI transactions issued.
+	uint32_t regions; ///< Windows (changed regions) sent.
+} frame_stats_t;
+
+/**
+ * @brief Function that produces pixels for lcd_drawLines().
+ * @param arg  Argument given to lcd_drawLines().
+ * @param line Receives n colors.
+ * @param x    First column, relative to the left of the block.
+ * @param y    Row, relative to the top of the block.
+ * @param n    Number of pixels to produce.
+ */
+typedef void (*lcd_line_t)(void *arg, color_t *line, coord_t x, coord_t y, coord_t n);
+
+/**
+ * @brief Offscreen drawing surface of RGB565 colors, see lcd_setCanvas().
+ * @details The pixels are owned by the caller. A canvas can also view part
+ *  of a larger one, see lcd_subCanvas().
+ */
+typedef struct {
+	color_t *pixels; ///< Top left pixel.
+	coord_t  width;  ///< Width in pixels.
+	coord_t  height; ///< Height in pixels.
+	coord_t  stride; ///< Pixels from the start of one row to the next.
+} canvas_t;
+
 /**
  * @brief Initialize the LCD module.
  */
@@ -85,6 +130,7 @@ void lcd_init(void);
 /**
  * @brief Fill the screen with one color.
  * @param color Color value.
+ * @note  When a clip rectangle is set, only that rectangle is filled.
  */
 void lcd_fillScreen(color_t color);
 
@@ -195,6 +241,19 @@ void lcd_drawCircle(coord_t xc, coord_t yc, coord_t r, color_t color);
  */
 void lcd_fillCircle(coord_t xc, coord_t yc, coord_t r, color_t color);
 
+/**
+ * @brief Get the rows of a filled circle as half-widths.
+ * @param r  Radius of circle.
+ * @param hw Receives r+1 half-widths. Rows yc-k and yc+k of a circle
+ *  drawn by lcd_fillCircle() cover columns xc-hw[k] to xc+hw[k].
+ * @return Number of half-widths written, 0 if r is negative.
+ * @note The tables for small radii are cached and shared with the circle
+ *  and rounded rectangle primitives, so an exact pixel coverage test
+ *  matches what is drawn: (x, y) is covered if |y-yc| <= r and
+ *  |x-xc| <= hw[|y-yc|].
+ */
+coord_t lcd_circleSpans(coord_t r, coord_t *hw);
+
 /**
  * @brief Draw a rounded rectangle with no fill color.
  * @param x     Top left corner X coordinate.
@@ -239,6 +298,18 @@ void lcd_drawArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, co
  */
 void lcd_fillArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, color_t color);
 
+/**
+ * @brief Draw a filled polygon.
+ * @param xy    Array of vertex coordinates, x0, y0, x1, y1, and so on.
+ * @param n     Number of vertices. The last vertex connects to the first.
+ * @param rule  Fill rule for overlapping parts, FILL_EVEN_ODD or
+ *  FILL_NONZERO. They differ only for self-intersecting polygons.
+ * @param color Color value.
+ * @note  The polygon may be concave or self-intersecting. Each pixel is
+ *  written once.
+ */
+void lcd_fillPolygon(const coord_t *xy, int n, fill_rule_t rule, color_t color);
+
 /**
  * @brief Draw a 1-bit image at the specified location using the specified
  *  color for set bits. Unset bits are transparent (no change to destination).
@@ -253,6 +324,21 @@ void lcd_fillArrow(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t w, co
  */
 void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color);
 
+/**
+ * @brief Draw a 1-bit image at the specified location using the specified
+ *  colors for set and unset bits. The whole image is opaque.
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param bitmap Byte array with monochrome bitmap, one bit for each pixel.
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ * @param color  Color value for set bits.
+ * @param bg     Color value for unset bits.
+ * @note  Each row of the bitmap array starts on a byte boundary, as with
+ *  lcd_drawBitmap().
+ */
+void lcd_drawBitmapBg(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coord_t h, color_t color, color_t bg);
+
 /**
  * @brief Draw an image at the specified location.
  * @param x      Top left corner X coordinate.
@@ -263,6 +349,41 @@ void lcd_drawBitmap(coord_t x, coord_t y, const uint8_t *bitmap, coord_t w, coor
  */
 void lcd_drawRGBBitmap(coord_t x, coord_t y, const color_t *bitmap, coord_t w, coord_t h);
 
+/**
+ * @brief Read an image from the frame buffer, the reverse of
+ *  lcd_drawRGBBitmap().
+ * @param x      Top left corner X coordinate.
+ * @param y      Top left corner Y coordinate.
+ * @param bitmap Receives color values, one for each pixel, length = w * h.
+ *  Pixels that are off screen are left unchanged.
+ * @param w      Width of bitmap in pixels.
+ * @param h      Height of bitmap in pixels.
+ * @returns True if read, false if there is no frame buffer to read from.
+ * @note  Unlike lcd_getFrameBuffer(), this does not mark the frame as
+ *  changed. With the indexed frame buffer, each pixel reads as the color
+ *  that selects its palette entry, so drawing it back is exact.
+ */
+bool lcd_readRGBBitmap(coord_t x, coord_t y, color_t *bitmap, coord_t w, coord_t h);
+
+/**
+ * @brief Draw a block whose pixels are produced one row at a time by a
+ *  function, such as a tile or sprite renderer.
+ * @param x    Top left corner X coordinate.
+ * @param y    Top left corner Y coordinate.
+ * @param w    Width of block in pixels.
+ * @param h    Height of block in pixels.
+ * @param line Function called once for each visible row, top to bottom,
+ *  with only the visible columns requested.
+ * @param arg  Argument passed to line.
+ * @note  Without a frame buffer, rows are produced straight into a pair of
+ *  DMA buffers, each sent while the other is filled, so a full screen
+ *  needs no more than a few rows of memory. With a frame buffer, rows are
+ *  produced in place and the block is marked changed once. If a buffer
+ *  cannot be allocated, the block is still drawn, more slowly, and line
+ *  may then be called for pieces of a row.
+ */
+void lcd_drawLines(coord_t x, coord_t y, coord_t w, coord_t h, lcd_line_t line, void *arg);
+
 /** @} */
 
 /** @name Rectangle variants that specify two diagonal corners. */
@@ -312,6 +433,38 @@ void lcd_fillRoundRect2(coord_t x0, coord_t y0, coord_t x1, coord_t y1, coord_t
 
 /** @} */
 
+/** @name Fixed-point trigonometry. */
+/** @{ */
+
+/**
+ * @brief Sine of an angle in Q15 fixed point (32767 is 1.0).
+ * @param angle Angle (degrees), any value.
+ * @return Sine from a table, -32767 to 32767.
+ */
+int16_t lcd_sinQ15(angle_t angle);
+
+/**
+ * @brief Cosine of an angle in Q15 fixed point (32767 is 1.0).
+ * @param angle Angle (degrees), any value.
+ * @return Cosine from a table, -32767 to 32767.
+ */
+int16_t lcd_cosQ15(angle_t angle);
+
+/**
+ * @brief Rotate a point around a center, the same way the primitives
+ *  that take a center point and angle rotate their vertices.
+ * @param x     X offset of the point from the center before rotation.
+ * @param y     Y offset of the point from the center before rotation.
+ * @param xc    Center X coordinate.
+ * @param yc    Center Y coordinate.
+ * @param angle Angle of rotation (degrees).
+ * @param xr    Receives the rotated X coordinate.
+ * @param yr    Receives the rotated Y coordinate.
+ */
+void lcd_rotatePoint(coord_t x, coord_t y, coord_t xc, coord_t yc, angle_t angle, coord_t *xr, coord_t *yr);
+
+/** @} */
+
 /** @name Specify center, size, and rotation angle of primitive shape. */
 /** @{ */
 
@@ -348,6 +501,17 @@ void lcd_drawTriangleC(coord_t xc, coord_t yc, coord_t w, coord_t h, angle_t ang
  */
 void lcd_drawRegularPolygonC(coord_t xc, coord_t yc, coord_t n, coord_t r, angle_t angle, color_t color);
 
+/**
+ * @brief Draw a filled regular polygon based on a center point.
+ * @param xc    Center X coordinate.
+ * @param yc    Center Y coordinate.
+ * @param n     Number of sides.
+ * @param r     Radius of polygon.
+ * @param angle Angle of rotation (degrees).
+ * @param color Color value.
+ */
+void lcd_fillRegularPolygonC(coord_t xc, coord_t yc, coord_t n, coord_t r, angle_t angle, color_t color);
+
 /** @} */
 
 /** @name Draw characters and strings. */
@@ -380,8 +544,11 @@ coord_t lcd_drawString(coord_t x, coord_t y, const char *ascii, color_t color);
 
 /**
  * @brief Set font direction.
- * @param dir Font direction.
- * @note Not implemented. Direction is always 0.
+ * @param dir Font direction. Text is rotated clockwise by the angle and
+ *  advances in that direction: right for 0, down for 90, left for 180 and
+ *  up for 270. The (x, y) passed to lcd_drawChar() and lcd_drawString() is
+ *  the corner that is top left in the rotated text, so for 180 it is the
+ *  bottom right corner of the first character.
  */
 void lcd_setFontDirection(direction_t dir);
 
@@ -443,6 +610,28 @@ void lcd_inversionOff(void);
  */
 void lcd_inversionOn(void);
 
+/**
+ * @brief Define the rows that are scrolled by lcd_scrollTo(). Rows above
+ *  and below the area stay fixed. The area starts unscrolled.
+ * @param top    First row of the scroll area.
+ * @param height Number of rows in the scroll area.
+ * @note  Scrolling is done by the display controller, so only a few bytes
+ *  are sent. Drawing is not affected: coordinates still address the
+ *  display memory, which is shown rotated within the area. Use
+ *  lcd_scrollArea(0, 0) to turn it off. An area that reaches past the
+ *  controller's gate lines (HW_LCD_GATE_LINES) is ignored.
+ */
+void lcd_scrollArea(coord_t top, coord_t height);
+
+/**
+ * @brief Scroll the area set by lcd_scrollArea(). The memory row at
+ *  top+line is shown at the top of the area, with the rows above it
+ *  wrapped around to the bottom.
+ * @param line Scroll position in rows, taken modulo the area height.
+ *  Increasing it scrolls the image up.
+ */
+void lcd_scrollTo(coord_t line);
+
 /** @} */
 
 /** @name Frame management. */
@@ -454,16 +643,103 @@ void lcd_inversionOn(void);
 void lcd_frameEnable(void);
 
 /**
- * @brief Deallocate the frame buffer and disable its use.
+ * @brief Deallocate the frame buffer, normal or indexed, and disable
+ *  its use.
  */
 void lcd_frameDisable(void);
 
+/**
+ * @brief Allocate an indexed frame buffer and enable its use. Pixels take
+ *  one byte instead of two, an index into a palette of 256 colors that is
+ *  expanded as the frame is sent.
+ * @note  Drawing functions still take colors. Each new color is given the
+ *  next palette entry; after 256 colors, the nearest entry is used.
+ *  lcd_getFrameBuffer() returns NULL and lcd_writeFrameAsync() behaves
+ *  like lcd_writeFrame().
+ */
+void lcd_frameEnableIndexed(void);
+
+/**
+ * @brief Get the palette entry used for a color in the indexed frame
+ *  buffer. The color is given an entry if it does not have one yet.
+ * @param color Color as passed to the drawing functions.
+ * @return Palette index.
+ */
+uint8_t lcd_paletteIndex(color_t color);
+
+/**
+ * @brief Change the displayed color of a palette entry. All pixels drawn
+ *  with that entry change on the next frame write, while drawing with the
+ *  original color still selects the entry.
+ * @param index Palette index from lcd_paletteIndex().
+ * @param color New displayed color.
+ */
+void lcd_paletteSet(uint8_t index, color_t color);
+
+/**
+ * @brief Enable band rendering, an alternative to the frame buffer that
+ *  uses a fraction of the memory. Drawing functions are recorded in a
+ *  display list. lcd_writeFrame() rasterizes the list into strips of a
+ *  few rows, each sent by DMA while the next one is rasterized.
+ * @param list_size Display list size in bytes. A line or filled rectangle
+ *  takes 12 bytes, a pixel row of width w takes 8+2*w bytes and an RGB
+ *  bitmap 16 bytes. Draws that do not fit are dropped with a warning.
+ * @note  The display list is cleared by lcd_fillScreen(), so start each
+ *  frame with it. Bitmaps passed to lcd_drawRGBBitmap() are referenced,
+ *  not copied, and must stay valid until the frame is written.
+ *  lcd_getFrameBuffer() returns NULL and lcd_wrapAround() has no effect.
+ */
+void lcd_bandEnable(uint32_t list_size);
+
+/**
+ * @brief Disable band rendering and free its memory.
+ */
+void lcd_bandDisable(void);
+
+/**
+ * @brief Store frame buffer pixels in panel byte order. The frame can then
+ *  be sent by DMA directly from the frame buffer with no copy.
+ * @param swapped True to store pixels byte swapped (see swap565()),
+ *  false for native order (default). Existing contents are converted.
+ * @note  Applies to the screen frame buffer even while a canvas is the
+ *  drawing target. Canvases are always in native order.
+ */
+void lcd_frameSwapped(bool swapped);
+
 /**
  * @brief Get the frame buffer.
  * @returns A pointer to the frame buffer or NULL if not allocated.
+ * @note  The whole frame is marked as changed, so the next frame write
+ *  sends everything. Use lcd_frameDamage() instead when possible.
+ * @note  After lcd_frameSwapped(true), pixels must be read and written
+ *  with swap565().
  */
 color_t *lcd_getFrameBuffer(void);
 
+/**
+ * @brief Mark a region of the frame buffer as changed. Only needed after
+ *  writing to the frame buffer directly; drawing functions do this
+ *  automatically.
+ * @param x Top left corner X coordinate.
+ * @param y Top left corner Y coordinate.
+ * @param w Width in pixels.
+ * @param h Height in pixels.
+ */
+void lcd_frameDamage(coord_t x, coord_t y, coord_t w, coord_t h);
+
+/**
+ * @brief Select how changes to the frame buffer are tracked.
+ * @param mode Damage tracking mode. DAMAGE_TILE suits many small, scattered
+ *  objects that a few bounding boxes would cover poorly.
+ */
+void lcd_frameDamageMode(damage_t mode);
+
+/**
+ * @brief Get statistics for the last frame write.
+ * @param stats Pointer to structure that receives the statistics.
+ */
+void lcd_getFrameStats(frame_stats_t *stats);
+
 /**
  * @brief Scroll image by one pixel between the start and end coordinates.
  * @param scroll Scroll direction.
@@ -474,10 +750,138 @@ color_t *lcd_getFrameBuffer(void);
 void lcd_wrapAround(scroll_t scroll, coord_t start, coord_t end);
 
 /**
- * @brief Write frame buffer to display. Requires frame buffer to be enabled.
+ * @brief Scroll image by n pixels between the start and end coordinates.
+ *  Pixels scrolled off one edge wrap around to the opposite edge.
+ * @param scroll Scroll direction.
+ * @param start  Start of range in X or Y (depends on scroll direction).
+ * @param end    End of range in X or Y (depends on scroll direction).
+ * @param n      Number of pixels to scroll.
+ * @note  Requires frame buffer to be enabled. Scrolling by n pixels takes
+ *  one pass over the range, the same as scrolling by one. For scrolling
+ *  whole rows of the screen up or down, see lcd_scrollArea(). While a
+ *  canvas is the drawing target, the canvas is scrolled.
+ */
+void lcd_wrapAroundN(scroll_t scroll, coord_t start, coord_t end, coord_t n);
+
+/**
+ * @brief Write frame buffer to display. Requires frame buffer or band
+ *  rendering to be enabled.
+ * @details Only the regions changed since the last frame write are sent.
+ *  When most of the frame has changed, the whole frame is sent. With band
+ *  rendering, the whole frame is sent if anything was drawn.
  */
 void lcd_writeFrame(void);
 
+/**
+ * @brief Write the frame buffer to the display through DMA and return
+ *  while the last rows are still being sent. Drawing into the frame
+ *  buffer may continue as soon as it returns.
+ * @note  Requires frame buffer to be enabled. Changed regions are copied
+ *  into two small DMA-capable strips, one filled while the other is sent,
+ *  so the copy overlaps the transfer and no second frame buffer is
+ *  needed. If the strips cannot be allocated, this function behaves like
+ *  lcd_writeFrame(). With band rendering, it returns while the last
+ *  strips are still being sent.
+ */
+void lcd_writeFrameAsync(void);
+
+/**
+ * @brief Wait for a frame started by lcd_writeFrameAsync() to finish.
+ *  Without a frame buffer, wait for queued drawing to reach the display.
+ */
+void lcd_waitFrame(void);
+
+/**
+ * @brief Write pixels held for write-combining to the display.
+ * @details Without a frame buffer, pixel-heavy functions such as
+ *  lcd_drawCircle(), lcd_drawRoundRect(), lcd_drawBitmap() and
+ *  lcd_drawChar() merge adjacent pixels of the same color into spans,
+ *  each written with a single window. Held spans are written before the
+ *  function returns, so this is normally not needed.
+ */
+void lcd_flush(void);
+
+/** @} */
+
+/** @name Clip rectangle and origin. */
+/** @{ */
+
+/**
+ * @brief Limit drawing to a rectangle of the screen or the current canvas.
+ * @param x Top left corner X coordinate.
+ * @param y Top left corner Y coordinate.
+ * @param w Width in pixels.
+ * @param h Height in pixels.
+ * @note  The rectangle is given in target coordinates, unaffected by
+ *  lcd_setOrigin(), and is clipped to the target. Primitives that fall
+ *  outside it are rejected by their bounding box before any pixel is
+ *  visited, and lines are clipped before they are rasterized.
+ */
+void lcd_setClip(coord_t x, coord_t y, coord_t w, coord_t h);
+
+/**
+ * @brief Allow drawing on the whole screen or current canvas again.
+ */
+void lcd_resetClip(void);
+
+/**
+ * @brief Move the origin of drawing coordinates.
+ * @param x Target X coordinate of drawing coordinate 0.
+ * @param y Target Y coordinate of drawing coordinate 0.
+ * @note  Drawing at (0, 0) after lcd_setOrigin(x, y) draws at (x, y) on
+ *  the screen or canvas. Together with lcd_setClip() this makes a
+ *  viewport: lcd_setClip(x, y, w, h) and lcd_setOrigin(x, y).
+ */
+void lcd_setOrigin(coord_t x, coord_t y);
+
+/** @} */
+
+/** @name Offscreen canvases. */
+/** @{ */
+
+/**
+ * @brief Set the target of all drawing functions.
+ * @param c Canvas to draw into, or NULL for the screen.
+ * @note  Drawing into a canvas is clipped to the canvas and uses the
+ *  frame buffer path of each primitive, with no change tracking. Frame,
+ *  band, scroll and display functions act on the screen and should only
+ *  be called while the screen is the target. The canvas structure is
+ *  referenced until the target changes. Each target has its own clip
+ *  rectangle and origin, a canvas starts with neither.
+ */
+void lcd_setCanvas(const canvas_t *c);
+
+/**
+ * @brief Get the current drawing target.
+ * @returns The canvas set by lcd_setCanvas(), or NULL for the screen.
+ */
+const canvas_t *lcd_getCanvas(void);
+
+/**
+ * @brief Make a canvas that views a rectangle of another one. Drawing into
+ *  the view is clipped to the rectangle, with (0, 0) at its top left.
+ * @param sub Receives the view.
+ * @param c   Canvas to view.
+ * @param x   Top left corner X coordinate in c.
+ * @param y   Top left corner Y coordinate in c.
+ * @param w   Width in pixels.
+ * @param h   Height in pixels.
+ * @returns True if the rectangle, clipped to c, is not empty.
+ */
+bool lcd_subCanvas(canvas_t *sub, const canvas_t *c, coord_t x, coord_t y, coord_t w, coord_t h);
+
+/**
+ * @brief Copy a canvas to the screen or into another canvas.
+ * @param src Canvas to copy.
+ * @param dst Destination canvas, or NULL for the screen.
+ * @param x   Top left corner X coordinate in the destination.
+ * @param y   Top left corner Y coordinate in the destination.
+ * @note  The current drawing target is not changed. In band mode the
+ *  canvas is recorded by reference, so its pixels must not change until
+ *  the frame is written.
+ */
+void lcd_blitCanvas(const canvas_t *src, const canvas_t *dst, coord_t x, coord_t y);
+
 /** @} */
 
 #endif // LCD_H_
@@ -0,0 +1,60 @@
+#include <string.h> // memcpy
+
+#include "lcd_kern.h"
+
+// Word type that may alias the 16-bit elements being filled or copied.
+typedef uint32_t __attribute__((__may_alias__)) word_t;
+
+#define WORD_ALIGNED(p) (((uintptr_t)(p) & (sizeof(word_t)-1)) == 0)
+
+// Swap the bytes of both 16-bit halves of a word.
+#define SWAP16X2(w) ((((w) & 0x00FF00FFUL) << 8) | (((w) >> 8) & 0x00FF00FFUL))
+
+void kern_fill16(uint16_t *dst, uint16_t c, size_t n)
+{
+	if (n && !WORD_ALIGNED(dst)) {*dst++ = c; n--;}
+
+	word_t w = ((word_t)c << 16) | c;
+	word_t *d = (word_t *)dst;
+	for (; n >= 8; n -= 8, d += 4) {
+		d[0] = w; d[1] = w; d[2] = w; d[3] = w;
+	}
+	for (; n >= 2; n -= 2) *d++ = w;
+
+	if (n) *(uint16_t *)d = c;
+}
+
+void kern_fill_rect16(uint16_t *dst, size_t stride, size_t w, size_t h, uint16_t c)
+{
+	if (w == stride) { // contiguous rows
+		kern_fill16(dst, c, w*h);
+		return;
+	}
+	for (; h; h--, dst += stride) kern_fill16(dst, c, w);
+}
+
+void kern_copy16(uint16_t *dst, const uint16_t *src, size_t n)
+{
+	memcpy(dst, src, n*sizeof(uint16_t));
+}
+
+void kern_copy16_swap(uint16_t *dst, const uint16_t *src, size_t n)
+{
+	if (n && !WORD_ALIGNED(dst)) {
+		*dst++ = (uint16_t)((*src << 8) | (*src >> 8));
+		src++; n--;
+	}
+	if (WORD_ALIGNED(src)) {
+		word_t *d = (word_t *)dst;
+		const word_t *s = (const word_t *)src;
+		for (; n >= 8; n -= 8, d += 4, s += 4) {
+			word_t w0 = s[0], w1 = s[1], w2 = s[2], w3 = s[3];
+			d[0] = SWAP16X2(w0); d[1] = SWAP16X2(w1);
+			d[2] = SWAP16X2(w2); d[3] = SWAP16X2(w3);
+		}
+		for (; n >= 2; n -= 2) {word_t w0 = *s++; *d++ = SWAP16X2(w0);}
+		dst = (uint16_t *)d;
+		src = (const uint16_t *)s;
+	}
+	for (; n; n--, src++) *dst++ = (uint16_t)((*src << 8) | (*src >> 8));
+}
@@ -0,0 +1,53 @@
+#ifndef LCD_KERN_H_
+#define LCD_KERN_H_
+/**
+ * @file
+ * @brief Fill and copy kernels for 16-bit pixels.
+ * @details Spans are processed a 32-bit word (two pixels) at a time once
+ *  the destination is word aligned. A leading or trailing pixel is
+ *  handled separately. Used by lcd.c for frame buffer writes, and public
+ *  so that components producing rows for lcd_drawLines() (tilemap,
+ *  compositor) can fill and copy them the same way. Checked against
+ *  per-pixel loops by the host build in host/.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Fill a span with one value.
+ * @param dst Destination.
+ * @param c   Value to store.
+ * @param n   Number of elements.
+ */
+void kern_fill16(uint16_t *dst, uint16_t c, size_t n);
+
+/**
+ * @brief Fill a rectangle with one value.
+ * @param dst    Top left element.
+ * @param stride Elements from one row to the next.
+ * @param w      Width in elements.
+ * @param h      Height in rows.
+ * @param c      Value to store.
+ */
+void kern_fill_rect16(uint16_t *dst, size_t stride, size_t w, size_t h, uint16_t c);
+
+/**
+ * @brief Copy a span.
+ * @param dst Destination.
+ * @param src Source, must not overlap the destination.
+ * @param n   Number of elements.
+ */
+void kern_copy16(uint16_t *dst, const uint16_t *src, size_t n);
+
+/**
+ * @brief Copy a span and swap the bytes of each element, converting
+ *  colors to or from panel byte order.
+ * @param dst Destination.
+ * @param src Source, either the destination itself (swap in place) or
+ *  not overlapping it.
+ * @param n   Number of elements.
+ */
+void kern_copy16_swap(uint16_t *dst, const uint16_t *src, size_t n);
+
+#endif // LCD_KERN_H_
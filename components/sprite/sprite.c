@@ -0,0 +1,243 @@
+
+#include <stdlib.h> // malloc, free
+
+#include "sprite.h"
+
+struct sprite {
+	const uint8_t *bitmap; // 1-bit image, or NULL
+	const color_t *image;  // RGB565 image, or NULL
+	color_t *under;        // pixels saved from under the drawn sprite
+	coord_t w, h;
+	coord_t x, y;          // position to draw at
+	coord_t dx, dy;        // position drawn at, if drawn
+	uint32_t seq;          // order drawn in, if drawn
+	uint32_t id;           // order created in
+	color_t color;         // set bit color of a 1-bit image
+	int8_t z;
+	bool used;
+	bool deleted;          // free after it is erased
+	bool visible;
+	bool drawn;            // on screen at (dx, dy)
+	bool saved;            // under holds the pixels at (dx, dy)
+	bool dirty;            // erase and redraw at the next update
+};
+
+static struct sprite pool[SPRITE_MAX];
+static sprite_t *order[SPRITE_MAX]; // sprites in use by z-order
+static uint32_t count; // sprites in use
+static uint32_t seq; // draw counter
+static uint32_t ids; // creation counter
+static color_t back; // erase color without a frame buffer
+
+
+// True if sprite a is drawn after sprite b.
+static bool above(const sprite_t *a, const sprite_t *b)
+{
+	return a->z > b->z || (a->z == b->z && a->id > b->id);
+}
+
+// True if sprites a and b overlap, a at (ax, ay), b at (bx, by).
+static bool overlap(const sprite_t *a, coord_t ax, coord_t ay, const sprite_t *b, coord_t bx, coord_t by)
+{
+	return ax < bx+b->w && bx < ax+a->w && ay < by+b->h && by < ay+a->h;
+}
+
+// Sort the sprites in use by z-order, keeping creation order for equal
+// z-orders. The list is short and nearly sorted.
+static void sort_order(void)
+{
+	for (uint32_t i = 1; i < count; i++) {
+		sprite_t *s = order[i];
+		uint32_t k = i;
+		for (; k > 0 && above(order[k-1], s); k--) order[k] = order[k-1];
+		order[k] = s;
+	}
+}
+
+// True if the pixels under a sprite can be read back, which needs a
+// frame buffer. Probed with a one pixel read.
+static bool can_read(void)
+{
+	color_t px;
+	return lcd_readRGBBitmap(0, 0, &px, 1, 1);
+}
+
+static sprite_t *new_sprite(coord_t w, coord_t h)
+{
+	if (count >= SPRITE_MAX) return NULL;
+	sprite_t *s = pool;
+	while (s->used) s++;
+	*s = (struct sprite){.w = w, .h = h, .id = ++ids, .used = true};
+	order[count++] = s;
+	sort_order();
+	return s;
+}
+
+// Put back the background under drawn sprites that are dirty, the most
+// recently drawn first, so overlapping sprites unwind correctly.
+static void erase_dirty(void)
+{
+	for (;;) {
+		sprite_t *s = NULL;
+		for (uint32_t i = 0; i < count; i++) {
+			sprite_t *t = order[i];
+			if (t->dirty && t->drawn && (s == NULL || t->seq > s->seq)) s = t;
+		}
+		if (s == NULL) break;
+		if (s->saved) lcd_drawRGBBitmap(s->dx, s->dy, s->under, s->w, s->h);
+		else lcd_fillRect(s->dx, s->dy, s->w, s->h, back);
+		s->drawn = false;
+	}
+	// Free deleted sprites now that they are off the screen.
+	uint32_t j = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		sprite_t *s = order[i];
+		if (s->deleted) {
+			free(s->under);
+			*s = (struct sprite){0}; // slot free, no dangling save buffer
+		} else {
+			order[j++] = s;
+		}
+	}
+	count = j;
+}
+
+// Initialize the sprite layer. Existing sprites are deleted without
+// being erased. Must be called before use.
+// bg: color that erases sprites when there is no frame buffer.
+void sprite_init(color_t bg)
+{
+	for (uint32_t i = 0; i < SPRITE_MAX; i++) {
+		free(pool[i].under);
+		pool[i] = (struct sprite){0};
+	}
+	count = 0;
+	seq = 0;
+	ids = 0;
+	back = bg;
+}
+
+// Create a sprite from a 1-bit bitmap with the same layout as used by
+// lcd_drawBitmap(). Set bits are drawn in color, clear bits are
+// transparent. The bitmap is referenced, not copied. The sprite starts
+// hidden at (0, 0) with z-order 0.
+// Return a sprite, or NULL if all are in use.
+sprite_t *sprite_new_bitmap(const uint8_t *bitmap, coord_t w, coord_t h, color_t color)
+{
+	sprite_t *s = new_sprite(w, h);
+	if (s == NULL) return NULL;
+	s->bitmap = bitmap;
+	s->color = color;
+	return s;
+}
+
+// Create a sprite from an opaque RGB565 image with the same layout as
+// used by lcd_drawRGBBitmap(). The image is referenced, not copied.
+// The sprite starts hidden at (0, 0) with z-order 0.
+// Return a sprite, or NULL if all are in use.
+sprite_t *sprite_new_image(const color_t *image, coord_t w, coord_t h)
+{
+	sprite_t *s = new_sprite(w, h);
+	if (s == NULL) return NULL;
+	s->image = image;
+	return s;
+}
+
+// Delete a sprite. It is erased at the next sprite_update().
+void sprite_delete(sprite_t *s)
+{
+	s->visible = false;
+	s->deleted = true;
+	s->dirty = true;
+}
+
+// Set the position of the top left corner of a sprite.
+void sprite_set_pos(sprite_t *s, coord_t x, coord_t y)
+{
+	if (x == s->x && y == s->y) return;
+	s->x = x;
+	s->y = y;
+	s->dirty = true;
+}
+
+// Set the z-order of a sprite. Sprites with a higher z-order are drawn
+// over those with a lower one. Equal z-orders draw in creation order.
+void sprite_set_z(sprite_t *s, int8_t z)
+{
+	if (z == s->z) return;
+	s->z = z;
+	s->dirty = true;
+	sort_order();
+}
+
+// Show or hide a sprite.
+void sprite_set_visible(sprite_t *s, bool visible)
+{
+	if (visible == s->visible) return;
+	s->visible = visible;
+	s->dirty = true;
+}
+
+// Set the color of a 1-bit bitmap sprite.
+void sprite_set_color(sprite_t *s, color_t color)
+{
+	if (color == s->color) return;
+	s->color = color;
+	s->dirty = true;
+}
+
+// Restore the background under sprites that changed and draw them at
+// their new state, along with any sprites they overlap. Call once per
+// frame, before lcd_writeFrame().
+void sprite_update(void)
+{
+	// A clean sprite that overlaps where a dirty one was or will be
+	// must also come off the screen and go back on top in order.
+	for (bool more = true; more; ) {
+		more = false;
+		for (uint32_t i = 0; i < count; i++) {
+			sprite_t *a = order[i];
+			if (!a->dirty) continue;
+			for (uint32_t j = 0; j < count; j++) {
+				sprite_t *b = order[j];
+				if (b->dirty || !b->drawn) continue;
+				if ((a->drawn && overlap(a, a->dx, a->dy, b, b->dx, b->dy)) ||
+					(a->visible && overlap(a, a->x, a->y, b, b->dx, b->dy))) {
+					b->dirty = true;
+					more = true;
+				}
+			}
+		}
+	}
+
+	erase_dirty();
+
+	bool readable = can_read();
+	for (uint32_t i = 0; i < count; i++) {
+		sprite_t *s = order[i];
+		if (!s->dirty) continue;
+		s->dirty = false;
+		if (!s->visible) continue;
+		s->saved = false;
+		if (readable) { // allocate the save buffer only when it can be filled
+			if (s->under == NULL) s->under = malloc(s->w * s->h * sizeof(color_t));
+			s->saved = s->under != NULL && lcd_readRGBBitmap(s->x, s->y, s->under, s->w, s->h);
+		}
+		if (s->bitmap != NULL) lcd_drawBitmap(s->x, s->y, s->bitmap, s->w, s->h, s->color);
+		else lcd_drawRGBBitmap(s->x, s->y, s->image, s->w, s->h);
+		s->dx = s->x;
+		s->dy = s->y;
+		s->seq = ++seq;
+		s->drawn = true;
+	}
+}
+
+// Remove all sprites from the screen, restoring the background under
+// them. The next sprite_update() draws the visible ones again.
+void sprite_erase(void)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		if (order[i]->drawn) order[i]->dirty = true;
+	}
+	erase_dirty();
+}
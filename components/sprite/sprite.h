@@ -0,0 +1,73 @@
+#ifndef SPRITE_H_
+#define SPRITE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lcd.h" // coord_t, color_t
+
+// This component moves images (sprites) over a background drawn with the
+// lcd component. Each sprite has a position, a 1-bit bitmap or an RGB565
+// image, and a z-order. sprite_update() puts back the background under
+// each sprite that changed and redraws only the sprites that changed or
+// overlap one that did, so the cost of a frame is proportional to the
+// size of the moving sprites, not to the size of the screen.
+//
+// With a frame buffer (normal or indexed), the pixels under a sprite are
+// saved when it is drawn and restored when it moves. Without one (direct
+// or band drawing) there is nothing to read back, no save buffer is
+// allocated, and the area a sprite leaves is filled with the background
+// color given to sprite_init().
+//
+// Sprites are drawn over whatever is in the frame at update time. To
+// redraw the background under visible sprites, call sprite_erase() first,
+// draw, then call sprite_update().
+
+#define SPRITE_MAX 32 // Sprites available at one time
+
+typedef struct sprite sprite_t;
+
+// Initialize the sprite layer. Existing sprites are deleted without
+// being erased. Must be called before use.
+// bg: color that erases sprites when there is no frame buffer.
+void sprite_init(color_t bg);
+
+// Create a sprite from a 1-bit bitmap with the same layout as used by
+// lcd_drawBitmap(). Set bits are drawn in color, clear bits are
+// transparent. The bitmap is referenced, not copied. The sprite starts
+// hidden at (0, 0) with z-order 0.
+// Return a sprite, or NULL if all are in use.
+sprite_t *sprite_new_bitmap(const uint8_t *bitmap, coord_t w, coord_t h, color_t color);
+
+// Create a sprite from an opaque RGB565 image with the same layout as
+// used by lcd_drawRGBBitmap(). The image is referenced, not copied.
+// The sprite starts hidden at (0, 0) with z-order 0.
+// Return a sprite, or NULL if all are in use.
+sprite_t *sprite_new_image(const color_t *image, coord_t w, coord_t h);
+
+// Delete a sprite. It is erased at the next sprite_update().
+void sprite_delete(sprite_t *s);
+
+// Set the position of the top left corner of a sprite.
+void sprite_set_pos(sprite_t *s, coord_t x, coord_t y);
+
+// Set the z-order of a sprite. Sprites with a higher z-order are drawn
+// over those with a lower one. Equal z-orders draw in creation order.
+void sprite_set_z(sprite_t *s, int8_t z);
+
+// Show or hide a sprite.
+void sprite_set_visible(sprite_t *s, bool visible);
+
+// Set the color of a 1-bit bitmap sprite.
+void sprite_set_color(sprite_t *s, color_t color);
+
+// Restore the background under sprites that changed and draw them at
+// their new state, along with any sprites they overlap. Call once per
+// frame, before lcd_writeFrame().
+void sprite_update(void);
+
+// Remove all sprites from the screen, restoring the background under
+// them. The next sprite_update() draws the visible ones again.
+void sprite_erase(void);
+
+#endif // SPRITE_H_
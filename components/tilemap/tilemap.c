@@ -0,0 +1,137 @@
+
+#include "lcd_kern.h" // kern_copy16, kern_fill16
+#include "tilemap.h"
+
+// Block of the screen being drawn by tilemap_draw().
+typedef struct {
+	const tilemap_t *tm;
+	coord_t x, y;
+} draw_t;
+
+// Wrap v into 0 to m-1.
+static coord_t wrap(coord_t v, coord_t m)
+{
+	v %= m;
+	return (v < 0) ? v+m : v;
+}
+
+static void draw_line(void *arg, color_t *line, coord_t x, coord_t y, coord_t n)
+{
+	const draw_t *d = arg;
+	tilemap_line(d->tm, line, d->x+x, d->y+y, n);
+}
+
+// Initialize a tilemap. The map is referenced, not copied.
+// *tm: pointer to tilemap.
+// *map: tile numbers, map_w*map_h of them, row by row.
+// map_w: map width in tiles.
+// map_h: map height in tiles.
+// size: tile width and height in pixels, 8 or 16.
+// Return zero if successful, or non-zero otherwise.
+int32_t tilemap_init(tilemap_t *tm, uint16_t *map, uint16_t map_w, uint16_t map_h, uint8_t size)
+{
+	if (map == NULL || map_w == 0 || map_h == 0) return -1;
+	if (size != 8 && size != 16) return -1;
+	*tm = (tilemap_t){
+		.map = map,
+		.map_w = map_w,
+		.map_h = map_h,
+		.shift = (size == 8) ? 3 : 4,
+	};
+	return 0;
+}
+
+// Use RGB565 tiles. Tile t is size*size colors, row by row, starting at
+// tiles[t*size*size]. The tiles are referenced, not copied.
+// *tm: pointer to tilemap.
+// *tiles: pointer to tile colors.
+void tilemap_set_tiles(tilemap_t *tm, const color_t *tiles)
+{
+	tm->tiles = tiles;
+	tm->itiles = NULL;
+}
+
+// Use palette-indexed tiles. Tile t is size*size bytes, row by row,
+// starting at tiles[t*size*size], each an index into palette. The tiles
+// and palette are referenced, not copied.
+// *tm: pointer to tilemap.
+// *tiles: pointer to tile indexes.
+// *palette: pointer to 256 colors.
+void tilemap_set_index_tiles(tilemap_t *tm, const uint8_t *tiles, const color_t *palette)
+{
+	tm->tiles = NULL;
+	tm->itiles = tiles;
+	tm->palette = palette;
+}
+
+// Set the tile number at a map position.
+// *tm: pointer to tilemap.
+// col: map column.
+// row: map row.
+// tile: tile number.
+void tilemap_set_tile(tilemap_t *tm, uint16_t col, uint16_t row, uint16_t tile)
+{
+	if (col >= tm->map_w || row >= tm->map_h) return;
+	tm->map[(size_t)row*tm->map_w + col] = tile;
+}
+
+// Set the scroll registers, the map pixel shown at the top left of the
+// screen. Values outside the map wrap around.
+// *tm: pointer to tilemap.
+// x: map X coordinate in pixels.
+// y: map Y coordinate in pixels.
+void tilemap_scroll(tilemap_t *tm, coord_t x, coord_t y)
+{
+	tm->scroll_x = wrap(x, (coord_t)tm->map_w << tm->shift);
+	tm->scroll_y = wrap(y, (coord_t)tm->map_h << tm->shift);
+}
+
+// Produce n pixels of row y of the layer, starting at column x, in screen
+// coordinates. The row is copied a tile row at a time.
+// *tm: pointer to tilemap.
+// *line: receives n colors.
+// x: screen X coordinate.
+// y: screen Y coordinate.
+// n: number of pixels.
+void tilemap_line(const tilemap_t *tm, color_t *line, coord_t x, coord_t y, coord_t n)
+{
+	uint8_t sh = tm->shift;
+	coord_t size = 1 << sh;
+	coord_t px = wrap(tm->scroll_x + x, (coord_t)tm->map_w << sh);
+	coord_t py = wrap(tm->scroll_y + y, (coord_t)tm->map_h << sh);
+	const uint16_t *row = tm->map + (size_t)(py >> sh)*tm->map_w;
+	size_t toff = (size_t)(py & (size-1)) << sh; // row within the tile
+	coord_t col = px >> sh;
+	coord_t tx = px & (size-1);
+
+	if (tm->tiles == NULL && tm->itiles == NULL) {
+		kern_fill16(line, BLACK, n);
+		return;
+	}
+	while (n > 0) {
+		coord_t m = (size-tx < n) ? size-tx : n;
+		size_t t = ((size_t)row[col] << (sh << 1)) + toff + tx;
+		if (tm->tiles != NULL) {
+			kern_copy16(line, tm->tiles+t, m);
+		} else {
+			const uint8_t *src = tm->itiles+t;
+			for (coord_t i = 0; i < m; i++) line[i] = tm->palette[src[i]];
+		}
+		line += m;
+		n -= m;
+		tx = 0;
+		if (++col == tm->map_w) col = 0;
+	}
+}
+
+// Draw the layer into a screen rectangle.
+// *tm: pointer to tilemap.
+// x: top left corner X coordinate.
+// y: top left corner Y coordinate.
+// w: width in pixels.
+// h: height in pixels.
+void tilemap_draw(const tilemap_t *tm, coord_t x, coord_t y, coord_t w, coord_t h)
+{
+	draw_t d = {tm, x, y};
+	lcd_drawLines(x, y, w, h, draw_line, &d);
+}
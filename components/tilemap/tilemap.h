@@ -0,0 +1,87 @@
+#ifndef TILEMAP_H_
+#define TILEMAP_H_
+
+#include <stdint.h>
+
+#include "lcd.h" // coord_t, color_t
+
+// This component draws a background layer made of square tiles, like the
+// background of a console video chip. A tile set holds 8x8 or 16x16 tiles
+// of RGB565 colors, or of 8-bit indexes into a palette. A map of tile
+// numbers, which may be larger than the screen, says which tile goes
+// where. Two scroll registers give the map pixel shown at the top left of
+// the screen. The map repeats in both directions, so any scroll position
+// is valid.
+//
+// Scrolling is a register change followed by tilemap_draw(), which sends
+// the layer row by row through lcd_drawLines(): straight into the SPI DMA
+// buffers in direct mode, or into the frame buffer when one is enabled.
+// tilemap_line() produces one row of the layer for other renderers.
+
+typedef struct {
+	uint16_t *map;           // tile numbers, map_w*map_h, row-major
+	uint16_t map_w, map_h;   // map size in tiles
+	uint8_t shift;           // log2 of the tile size
+	const color_t *tiles;    // RGB565 tiles, or NULL
+	const uint8_t *itiles;   // palette-indexed tiles, or NULL
+	const color_t *palette;  // colors for palette-indexed tiles
+	coord_t scroll_x;        // map pixel at the left edge of the screen
+	coord_t scroll_y;        // map pixel at the top edge of the screen
+} tilemap_t;
+
+
+// Initialize a tilemap. The map is referenced, not copied.
+// *tm: pointer to tilemap.
+// *map: tile numbers, map_w*map_h of them, row by row.
+// map_w: map width in tiles.
+// map_h: map height in tiles.
+// size: tile width and height in pixels, 8 or 16.
+// Return zero if successful, or non-zero otherwise.
+int32_t tilemap_init(tilemap_t *tm, uint16_t *map, uint16_t map_w, uint16_t map_h, uint8_t size);
+
+// Use RGB565 tiles. Tile t is size*size colors, row by row, starting at
+// tiles[t*size*size]. The tiles are referenced, not copied.
+// *tm: pointer to tilemap.
+// *tiles: pointer to tile colors.
+void tilemap_set_tiles(tilemap_t *tm, const color_t *tiles);
+
+// Use palette-indexed tiles. Tile t is size*size bytes, row by row,
+// starting at tiles[t*size*size], each an index into palette. The tiles
+// and palette are referenced, not copied.
+// *tm: pointer to tilemap.
+// *tiles: pointer to tile indexes.
+// *palette: pointer to 256 colors.
+void tilemap_set_index_tiles(tilemap_t *tm, const uint8_t *tiles, const color_t *palette);
+
+// Set the tile number at a map position.
+// *tm: pointer to tilemap.
+// col: map column.
+// row: map row.
+// tile: tile number.
+void tilemap_set_tile(tilemap_t *tm, uint16_t col, uint16_t row, uint16_t tile);
+
+// Set the scroll registers, the map pixel shown at the top left of the
+// screen. Values outside the map wrap around.
+// *tm: pointer to tilemap.
+// x: map X coordinate in pixels.
+// y: map Y coordinate in pixels.
+void tilemap_scroll(tilemap_t *tm, coord_t x, coord_t y);
+
+// Produce n pixels of row y of the layer, starting at column x, in screen
+// coordinates.
+// *tm: pointer to tilemap.
+// *line: receives n colors.
+// x: screen X coordinate.
+// y: screen Y coordinate.
+// n: number of pixels.
+void tilemap_line(const tilemap_t *tm, color_t *line, coord_t x, coord_t y, coord_t n);
+
+// Draw the layer into a screen rectangle.
+// *tm: pointer to tilemap.
+// x: top left corner X coordinate.
+// y: top left corner Y coordinate.
+// w: width in pixels.
+// h: height in pixels.
+void tilemap_draw(const tilemap_t *tm, coord_t x, coord_t y, coord_t w, coord_t h);
+
+#endif // TILEMAP_H_
@@ -124,7 +124,7 @@ void app_main(void)
 		}
 #endif // CONFIG_ERASE
 		cursor(x, y, CONFIG_COLOR_CURSOR);
-		lcd_writeFrame();
+		lcd_writeFrameAsync();
 		t2 = esp_timer_get_time() - t1;
 		if (t2 > tmax) tmax = t2;
 	}
@@ -3,6 +3,7 @@
 #include <stdlib.h> // rand, srand
 #include <string.h> // strcpy, strlen
 #include <time.h> // time (used with srand)
+#include <math.h> // sinf, cosf, lroundf
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -10,6 +11,10 @@
 #include "esp_timer.h" // esp_timer_get_time
 
 #include "lcd.h"
+#include "lcd_kern.h"
+#include "sprite.h"
+#include "tilemap.h"
+#include "compositor.h"
 #include "crosshair.h"
 #include "peppers.h"
 
@@ -88,7 +93,30 @@ int64_t test_lcd_fillScreen(void) {
 	return diffTick;
 }
 
-// test_lcd_drawPixel
+#define PIXEL_CNT 10000
+
+// In direct mode, window setup dominates the cost of a pixel. For a
+// before and after comparison, set DIRECT_QUEUE to 0 in lcd.c.
+int64_t test_lcd_drawPixel(void) {
+	int64_t startTick, endTick, diffTick;
+
+	lcd_fillScreen(BLACK);
+	lcd_waitFrame();
+
+	srand(1);
+	startTick = esp_timer_get_time();
+	for (int32_t i = 0; i < PIXEL_CNT; i++) {
+		lcd_drawPixel(rand() % width, rand() % height, RAND_COLOR());
+	}
+	lcd_waitFrame(); // include queued transactions
+	endTick = esp_timer_get_time();
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time per pixel[ns]:%"PRIi64,diffTick*1000/PIXEL_CNT);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
 
 // test_lcd_drawHPixels
 
@@ -273,6 +301,77 @@ int64_t test_lcd_fillCircle(void) {
 	return diffTick;
 }
 
+#define EXPLODE_OBJS 12 // CONFIG_MAX_TOTAL_MISSILES in lab06
+#define EXPLODE_MAX_R 25 // CONFIG_EXPLOSION_MAX_RADIUS in lab06
+#define EXPLODE_TICKS (EXPLODE_MAX_R*4)
+
+// Grow and shrink missile command sized explosions, all of them every
+// tick, and report the drawing time per tick without the frame write.
+int64_t test_lcd_fillCircleExplode(void) {
+	int64_t startTick, endTick, diffTick;
+	coord_t xpos[EXPLODE_OBJS], ypos[EXPLODE_OBJS];
+
+	lcd_fillScreen(BLACK);
+	srand((unsigned int)time(NULL));
+	for (int32_t i = 0; i < EXPLODE_OBJS; i++) {
+		xpos[i] = rand() % width;
+		ypos[i] = rand() % height;
+	}
+
+	startTick = esp_timer_get_time();
+	for (int32_t t = 0; t < EXPLODE_TICKS; t++) {
+		for (int32_t i = 0; i < EXPLODE_OBJS; i++) {
+			// Stagger the explosions so all radii are drawn each tick.
+			coord_t phase = (t + i*EXPLODE_MAX_R*2/EXPLODE_OBJS) % (EXPLODE_MAX_R*2);
+			coord_t radius = (phase < EXPLODE_MAX_R) ? phase : EXPLODE_MAX_R*2-phase;
+			lcd_fillCircle(xpos[i], ypos[i], radius+1, BLACK);
+			lcd_fillCircle(xpos[i], ypos[i], radius, (i & 1) ? YELLOW : RED);
+		}
+	}
+	endTick = esp_timer_get_time();
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time per tick[us]:%"PRIi64, diffTick/EXPLODE_TICKS);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+// Check that the spans from lcd_circleSpans() cover exactly the pixels
+// drawn by lcd_fillCircle(), and time the queries.
+int64_t test_lcd_circleSpans(void) {
+	int64_t startTick, endTick, diffTick = 0;
+	coord_t hw[EXPLODE_MAX_R*2+1];
+	coord_t xc = width/2, yc = height/2;
+	uint32_t errors = 0;
+
+	color_t *fb = lcd_getFrameBuffer();
+	if (fb == NULL) return 0;
+
+	for (coord_t r = 0; r <= EXPLODE_MAX_R*2; r++) {
+		lcd_fillScreen(BLACK);
+		lcd_fillCircle(xc, yc, r, WHITE);
+		startTick = esp_timer_get_time();
+		coord_t n = lcd_circleSpans(r, hw);
+		endTick = esp_timer_get_time();
+		diffTick += endTick - startTick;
+		if (n != r+1) {errors++; continue;}
+		for (coord_t y = yc-r-1; y <= yc+r+1; y++) {
+			for (coord_t x = xc-r-1; x <= xc+r+1; x++) {
+				coord_t dy = (y < yc) ? yc-y : y-yc;
+				coord_t dx = (x < xc) ? xc-x : x-xc;
+				bool in = dy <= r && dx <= hw[dy];
+				if (in != (fb[y*width+x] != BLACK)) errors++;
+			}
+		}
+	}
+
+	lcd_writeFrame();
+	ESP_LOGI(__FUNCTION__, "pixel errors:%lu", errors);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
 int64_t test_lcd_drawRoundRect(void) {
 	int64_t startTick, endTick, diffTick;
 
@@ -419,6 +518,28 @@ int64_t test_lcd_drawBitmap(void) {
 	return diffTick;
 }
 
+int64_t test_lcd_drawBitmapBg(void) {
+	int64_t startTick, endTick, diffTick;
+
+	color_t ctab[] = {RED,GREEN,BLUE,BLACK,GRAY,YELLOW,CYAN,MAGENTA};
+	lcd_fillScreen(rgb565(4, 16, 64));
+
+	startTick = esp_timer_get_time();
+	for (coord_t y = 0; y < LCD_H; y += CROSSHAIR_H+1) {
+		coord_t x;
+		uint8_t c;
+		for (x = 0, c = 0; x < LCD_W; x += CROSSHAIR_W+1, c++) {
+			lcd_drawBitmapBg(x, y, crosshair, CROSSHAIR_W, CROSSHAIR_H, ctab[c%8], ctab[(c+1)%8]);
+		}
+	}
+	endTick = esp_timer_get_time();
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
 int64_t test_lcd_drawRGBBitmap(void) {
 	int64_t startTick, endTick, diffTick;
 	coord_t x = 0, y = 0;
@@ -531,6 +652,40 @@ int64_t test_lcd_fillRoundRect2(void) {
 	return diffTick;
 }
 
+//----------------------------------------------------------------------------//
+// Fixed-point trigonometry
+//----------------------------------------------------------------------------//
+
+// Compare the Q15 table with sinf() and cosf() over two turns, then time
+// rotating a point by every whole degree.
+int64_t test_lcd_sinQ15(void) {
+	int64_t startTick, endTick, diffTick;
+	int32_t maxErr = 0;
+
+	for (angle_t a = -360; a < 360; a++) {
+		float rd = a * 3.14159265f / 180.0f;
+		int32_t es = abs(lcd_sinQ15(a) - (int32_t)lroundf(sinf(rd) * 32767.0f));
+		int32_t ec = abs(lcd_cosQ15(a) - (int32_t)lroundf(cosf(rd) * 32767.0f));
+		if (es > maxErr) maxErr = es;
+		if (ec > maxErr) maxErr = ec;
+	}
+	ESP_LOGI(__FUNCTION__, "max error[Q15]:%ld", maxErr);
+
+	coord_t x, y;
+	int32_t sum = 0;
+	startTick = esp_timer_get_time();
+	for (angle_t a = 0; a < 360; a++) {
+		lcd_rotatePoint(100, 50, width/2, height/2, a, &x, &y);
+		sum += x + y;
+	}
+	endTick = esp_timer_get_time();
+	ESP_LOGI(__FUNCTION__, "checksum:%ld", sum);
+
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
 //----------------------------------------------------------------------------//
 // Specify center, size, and rotation angle of primitive shape
 //----------------------------------------------------------------------------//
@@ -615,6 +770,72 @@ int64_t test_lcd_drawRegularPolygonC(void) {
 	return diffTick;
 }
 
+int64_t test_lcd_fillRegularPolygonC(void) {
+	int64_t startTick, endTick, diffTick;
+
+	color_t coltab[] = {RED,GREEN,BLUE,YELLOW,CYAN,MAGENTA,GRAY,WHITE};
+	coord_t xpos = width/2;
+	coord_t ypos = height/2;
+	coord_t limit = width;
+	if (width > height) limit = height;
+	limit /= 2;
+	coord_t last = 3;
+	lcd_fillScreen(BLACK);
+
+	while ((last+1)*15-35 < limit) last++;
+	startTick = esp_timer_get_time();
+	for (coord_t n = last; n >= 3; n--) {
+		coord_t radius = n*15-35;
+		angle_t angle = n*10;
+		lcd_fillRegularPolygonC(xpos, ypos, n, radius, angle, coltab[n&7]);
+	}
+	endTick = esp_timer_get_time();
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+int64_t test_lcd_fillPolygon(void) {
+	int64_t startTick, endTick, diffTick;
+
+	color_t coltab[] = {RED,GREEN,BLUE,YELLOW,CYAN,MAGENTA,GRAY,WHITE};
+	coord_t star[2*10];
+	coord_t r = ((height < width) ? height : width) / 6;
+	lcd_fillScreen(BLACK);
+	srand((unsigned int)time(NULL));
+
+	startTick = esp_timer_get_time();
+	for (int32_t i = 0; i < 100; i++) {
+		coord_t xc = rand() % width;
+		coord_t yc = rand() % height;
+		angle_t angle = rand() % 72;
+		// Concave five-pointed star: alternate outer and inner radius.
+		for (int32_t k = 0; k < 10; k++) {
+			coord_t rk = (k & 1) ? r*2/5 : r;
+			lcd_rotatePoint(rk, 0, xc, yc, angle + k*36 - 90, &star[2*k], &star[2*k+1]);
+		}
+		lcd_fillPolygon(star, 10, FILL_EVEN_ODD, coltab[i&7]);
+	}
+	endTick = esp_timer_get_time();
+
+	// Self-intersecting pentagram: even-odd leaves the center empty,
+	// nonzero fills it.
+	for (int32_t rule = FILL_EVEN_ODD; rule <= FILL_NONZERO; rule++) {
+		coord_t xc = width/4 + rule*width/2;
+		for (int32_t k = 0; k < 5; k++) {
+			lcd_rotatePoint(r, 0, xc, height/2, k*144 - 90, &star[2*k], &star[2*k+1]);
+		}
+		lcd_fillPolygon(star, 5, (fill_rule_t)rule, WHITE);
+	}
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
 //----------------------------------------------------------------------------//
 // Draw characters and strings
 //----------------------------------------------------------------------------//
@@ -672,7 +893,6 @@ int64_t test_lcd_setFontDirection(void) {
 	lcd_setFontDirection(DIRECTION0);
 	lcd_drawString(0, 0, ascii, color);
 
-#if 0 // other directions unimplemented
 	color = BLUE;
 	strcpy(ascii, "Direction=180");
 	lcd_setFontDirection(DIRECTION180);
@@ -687,7 +907,6 @@ int64_t test_lcd_setFontDirection(void) {
 	strcpy(ascii, "Direction=270");
 	lcd_setFontDirection(DIRECTION270);
 	lcd_drawString(0, height-1, ascii, color);
-#endif
 	endTick = esp_timer_get_time();
 
 	lcd_writeFrame();
@@ -738,6 +957,26 @@ int64_t test_lcd_setFontSize(void) {
 // test_lcd_inversionOff
 // test_lcd_inversionOn
 
+// Scroll the middle half of the screen through a full cycle in hardware,
+// one row at a time.
+int64_t test_lcd_scrollArea(void) {
+	int64_t startTick, endTick, diffTick;
+
+	lcd_fillScreen(BLACK);
+	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
+	lcd_writeFrame();
+
+	startTick = esp_timer_get_time();
+	lcd_scrollArea(height/4, height/2);
+	for (coord_t i = 0; i <= height/2; i++) lcd_scrollTo(i);
+	lcd_scrollArea(0, 0);
+	endTick = esp_timer_get_time();
+
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
 //----------------------------------------------------------------------------//
 // Frame management
 //----------------------------------------------------------------------------//
@@ -746,6 +985,398 @@ int64_t test_lcd_setFontSize(void) {
 // test_lcd_frameDisable
 // test_lcd_getFrameBuffer
 
+#define REPLAY_FRAMES 100
+#define REPLAY_OBJS 10
+
+// Replay a missile command style sequence (moving trails, growing
+// explosions and a cursor) and report bytes and transactions per frame
+// for each damage tracking mode.
+int64_t test_lcd_frameDamageMode(void) {
+	int64_t startTick, endTick, diffTick = 0;
+	static const char *mtab[] = {"none", "rect", "tile"};
+	frame_stats_t stats;
+
+	if (lcd_getFrameBuffer() == NULL) return 0;
+
+	for (damage_t mode = DAMAGE_NONE; mode <= DAMAGE_TILE; mode++) {
+		coord_t x0[REPLAY_OBJS], x1[REPLAY_OBJS], y1[REPLAY_OBJS];
+		uint32_t bytes = 0, trans = 0;
+
+		srand(1); // same sequence for each mode
+		for (int32_t i = 0; i < REPLAY_OBJS; i++) {
+			x0[i] = rand() % width;
+			x1[i] = rand() % width;
+			y1[i] = height/2 + rand() % (height/2);
+		}
+		lcd_frameDamageMode(mode);
+		lcd_fillScreen(BLACK);
+		lcd_writeFrame();
+
+		startTick = esp_timer_get_time();
+		for (int32_t f = 1; f <= REPLAY_FRAMES; f++) {
+			for (int32_t i = 0; i < REPLAY_OBJS; i++) {
+				coord_t xe = x0[i] + (x1[i]-x0[i]) * f / REPLAY_FRAMES;
+				coord_t ye = y1[i] * f / REPLAY_FRAMES;
+				if (i & 1) lcd_drawLine(x0[i], 0, xe, ye, RED);
+				else lcd_fillCircle(x1[i], y1[i], f % 25, (f % 25) ? YELLOW : BLACK);
+			}
+			lcd_drawHLine(f*3 % width - 3, height/3, 7, WHITE);
+			lcd_writeFrame();
+			lcd_getFrameStats(&stats);
+			bytes += stats.bytes;
+			trans += stats.trans;
+		}
+		endTick = esp_timer_get_time();
+
+		ESP_LOGI(__FUNCTION__, "%s: bytes per frame:%lu, transactions per frame:%lu",
+			mtab[mode], bytes/REPLAY_FRAMES, trans/REPLAY_FRAMES);
+		diffTick += endTick - startTick;
+	}
+	lcd_frameDamageMode(DAMAGE_RECT);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define SPRITE_OBJS 20
+#define SPRITE_FRAMES 100
+#define SPRITE_SZ 16
+
+// Move sprites over an image and report bytes sent per frame, which
+// should follow the sprite sizes rather than the screen size.
+int64_t test_lcd_sprite(void) {
+	int64_t startTick, endTick, diffTick;
+	static color_t block[SPRITE_SZ*SPRITE_SZ];
+	sprite_t *spr[SPRITE_OBJS];
+	coord_t x[SPRITE_OBJS], y[SPRITE_OBJS], vx[SPRITE_OBJS], vy[SPRITE_OBJS];
+	frame_stats_t stats;
+	uint32_t bytes = 0;
+
+	bool frame = lcd_getFrameBuffer() != NULL;
+	for (int32_t i = 0; i < SPRITE_SZ*SPRITE_SZ; i++) {
+		block[i] = (i / SPRITE_SZ + i % SPRITE_SZ) & 4 ? RED : WHITE;
+	}
+	srand((unsigned int)time(NULL));
+	sprite_init(BLACK);
+	for (int32_t i = 0; i < SPRITE_OBJS; i++) {
+		if (i & 1) spr[i] = sprite_new_bitmap(crosshair, CROSSHAIR_W, CROSSHAIR_H, RAND_COLOR());
+		else spr[i] = sprite_new_image(block, SPRITE_SZ, SPRITE_SZ);
+		x[i] = rand() % (width-SPRITE_SZ);
+		y[i] = rand() % (height-SPRITE_SZ);
+		vx[i] = rand() % 7 - 3;
+		vy[i] = rand() % 7 - 3;
+		sprite_set_pos(spr[i], x[i], y[i]);
+		sprite_set_z(spr[i], i % 3);
+		sprite_set_visible(spr[i], true);
+	}
+	lcd_fillScreen(BLACK);
+	lcd_drawRGBBitmap((width-PEPPERS_W)/2, (height-PEPPERS_H)/2, peppers, PEPPERS_W, PEPPERS_H);
+	sprite_update();
+	lcd_writeFrame();
+
+	startTick = esp_timer_get_time();
+	for (int32_t f = 0; f < SPRITE_FRAMES; f++) {
+		for (int32_t i = 0; i < SPRITE_OBJS; i++) {
+			x[i] += vx[i];
+			y[i] += vy[i];
+			if (x[i] < 0 || x[i] > width-SPRITE_SZ) vx[i] = -vx[i];
+			if (y[i] < 0 || y[i] > height-SPRITE_SZ) vy[i] = -vy[i];
+			sprite_set_pos(spr[i], x[i], y[i]);
+		}
+		sprite_update();
+		lcd_writeFrame();
+		if (frame) {
+			lcd_getFrameStats(&stats);
+			bytes += stats.bytes;
+		}
+	}
+	endTick = esp_timer_get_time();
+
+	if (frame) ESP_LOGI(__FUNCTION__, "bytes per frame:%lu", bytes/SPRITE_FRAMES);
+	sprite_init(BLACK);
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define TILE_SZ 16
+#define TILE_CNT 4
+#define TMAP_W 48 // map size in tiles, larger than the screen
+#define TMAP_H 40
+#define TMAP_FRAMES 100
+
+// Scroll a tilemap diagonally across the screen and report the time per
+// frame, including the frame write.
+int64_t test_lcd_tilemap(void) {
+	int64_t startTick, endTick, diffTick;
+	static color_t tiles[TILE_CNT*TILE_SZ*TILE_SZ];
+	static uint16_t map[TMAP_W*TMAP_H];
+	color_t ctab[TILE_CNT] = {BLUE, GREEN, YELLOW, MAGENTA};
+	tilemap_t tm;
+
+	for (int32_t t = 0; t < TILE_CNT; t++) {
+		for (int32_t i = 0; i < TILE_SZ*TILE_SZ; i++) {
+			coord_t r = i / TILE_SZ, c = i % TILE_SZ;
+			tiles[t*TILE_SZ*TILE_SZ+i] = (r == 0 || c == 0) ? BLACK : (r+c+t) & 4 ? ctab[t] : WHITE;
+		}
+	}
+	srand((unsigned int)time(NULL));
+	for (int32_t i = 0; i < TMAP_W*TMAP_H; i++) map[i] = rand() % TILE_CNT;
+	if (tilemap_init(&tm, map, TMAP_W, TMAP_H, TILE_SZ)) return 0;
+	tilemap_set_tiles(&tm, tiles);
+
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < TMAP_FRAMES; f++) {
+		tilemap_scroll(&tm, f*3, f*2);
+		tilemap_draw(&tm, 0, 0, width, height);
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time per frame[us]:%"PRIi64, diffTick/TMAP_FRAMES);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define COMP_BALLS 16
+#define BALL_SZ 24
+
+// Compose a scrolling tilemap under moving sprites line by line, with no
+// frame buffer, and report the time per frame.
+int64_t test_lcd_compositor(void) {
+	int64_t startTick, endTick, diffTick;
+	static color_t tiles[TILE_CNT*TILE_SZ*TILE_SZ];
+	static uint16_t map[TMAP_W*TMAP_H];
+	static color_t ball[BALL_SZ*BALL_SZ];
+	static compositor_t comp;
+	coord_t vx[COMP_BALLS], vy[COMP_BALLS];
+	tilemap_t tm;
+
+	for (int32_t t = 0; t < TILE_CNT; t++) {
+		for (int32_t i = 0; i < TILE_SZ*TILE_SZ; i++) {
+			coord_t r = i / TILE_SZ, c = i % TILE_SZ;
+			tiles[t*TILE_SZ*TILE_SZ+i] = (r == 0 || c == 0) ? GRAY : (t & 1) ? BLUE : GREEN;
+		}
+	}
+	for (int32_t i = 0; i < BALL_SZ*BALL_SZ; i++) {
+		coord_t dx = 2*(i % BALL_SZ) - BALL_SZ + 1, dy = 2*(i / BALL_SZ) - BALL_SZ + 1;
+		ball[i] = (dx*dx + dy*dy > BALL_SZ*BALL_SZ) ? BLACK : RED;
+	}
+	srand((unsigned int)time(NULL));
+	for (int32_t i = 0; i < TMAP_W*TMAP_H; i++) map[i] = rand() % TILE_CNT;
+	if (tilemap_init(&tm, map, TMAP_W, TMAP_H, TILE_SZ)) return 0;
+	tilemap_set_tiles(&tm, tiles);
+	compositor_init(&comp, &tm, BLACK);
+	for (int32_t i = 0; i < COMP_BALLS; i++) {
+		comp_sprite_t *s = &comp.sprite[i];
+		compositor_set_sprite(&comp, i, ball, BALL_SZ, BALL_SZ, BLACK);
+		s->x = rand() % (width-BALL_SZ);
+		s->y = rand() % (height-BALL_SZ);
+		s->visible = true;
+		vx[i] = rand() % 7 - 3;
+		vy[i] = rand() % 7 - 3;
+	}
+
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < TMAP_FRAMES; f++) {
+		tilemap_scroll(&tm, f, f);
+		for (int32_t i = 0; i < COMP_BALLS; i++) {
+			comp_sprite_t *s = &comp.sprite[i];
+			s->x += vx[i];
+			s->y += vy[i];
+			if (s->x < 0 || s->x > width-BALL_SZ) vx[i] = -vx[i];
+			if (s->y < 0 || s->y > height-BALL_SZ) vy[i] = -vy[i];
+		}
+		compositor_draw(&comp);
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time per frame[us]:%"PRIi64", lines with dropped sprites:%lu",
+		diffTick/TMAP_FRAMES, comp.overflow);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define CAR_W 64
+#define CAR_H 32
+#define CAR_FRAMES 100
+
+// Composite sprite made of several primitives, top left at (x, y).
+static void draw_car(coord_t x, coord_t y)
+{
+	lcd_fillRect(x, y, CAR_W, CAR_H, BLACK);
+	lcd_fillRect(x+14, y+2, 30, 8, BLUE);
+	lcd_fillRoundRect(x+2, y+8, 60, 14, 4, RED);
+	lcd_drawLine(x+2, y+15, x+61, y+15, YELLOW);
+	lcd_fillCircle(x+14, y+24, 6, GRAY);
+	lcd_fillCircle(x+48, y+24, 6, GRAY);
+	lcd_drawString(x+24, y+11, "CAR", WHITE);
+}
+
+int64_t test_lcd_canvas(void) {
+	int64_t startTick, endTick, diffTick, drawTick;
+	static color_t pixels[CAR_W*CAR_H];
+	canvas_t car = {pixels, CAR_W, CAR_H, CAR_W};
+
+	lcd_setCanvas(&car);
+	draw_car(0, 0);
+	lcd_setCanvas(NULL);
+
+	lcd_fillScreen(BLACK);
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < CAR_FRAMES; f++) {
+		draw_car(f*(width-CAR_W)/CAR_FRAMES, height/4);
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+	drawTick = endTick - startTick;
+
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < CAR_FRAMES; f++) {
+		lcd_blitCanvas(&car, NULL, f*(width-CAR_W)/CAR_FRAMES, height/2);
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time per frame[us] draw:%"PRIi64" blit:%"PRIi64,
+		drawTick/CAR_FRAMES, diffTick/CAR_FRAMES);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define BANNER_W (LCD_W*2) // wider than any screen row
+#define BANNER_H (LCD_CHAR_H*2)
+#define BANNER_FRAMES 100
+
+// Draw a line of text with a background into a canvas wider than the
+// screen, then scroll it across the screen by copying views of it.
+int64_t test_lcd_canvasText(void) {
+	int64_t startTick, endTick, diffTick, drawTick;
+	static color_t pixels[BANNER_W*BANNER_H];
+	canvas_t banner = {pixels, BANNER_W, BANNER_H, BANNER_W};
+	canvas_t view;
+	char msg[BANNER_W/(LCD_CHAR_W*2)+1];
+
+	for (size_t i = 0; i < sizeof(msg)-1; i++) msg[i] = 'A' + i%26;
+	msg[sizeof(msg)-1] = '\0';
+
+	startTick = esp_timer_get_time();
+	lcd_setCanvas(&banner);
+	lcd_fillScreen(BLUE);
+	lcd_setFontSize(2);
+	lcd_setFontBackground(BLUE);
+	lcd_drawString(0, 0, msg, WHITE);
+	lcd_noFontBackground();
+	lcd_setFontSize(1);
+	lcd_setCanvas(NULL);
+	endTick = esp_timer_get_time();
+	drawTick = endTick - startTick;
+
+	lcd_fillScreen(BLACK);
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < BANNER_FRAMES; f++) {
+		if (lcd_subCanvas(&view, &banner, f*(BANNER_W-width)/BANNER_FRAMES, 0, width, BANNER_H)) {
+			lcd_blitCanvas(&view, NULL, 0, height/2);
+		}
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time[us] draw:%"PRIi64" per frame:%"PRIi64,
+		drawTick, diffTick/BANNER_FRAMES);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define CLIP_FRAMES 100
+#define CLIP_MSG_H (LCD_CHAR_H*2+4) // message area at the bottom
+
+// Busy scene of lines that reach far off screen and a message line.
+static void draw_clip_scene(coord_t f)
+{
+	for (coord_t i = 0; i < 32; i++) {
+		coord_t a = (i*width*4)/32 - width*3/2;
+		lcd_drawLine(width/2, height/2, a, -height, (i+f) & 1 ? WHITE : BLUE);
+		lcd_drawLine(width/2, height/2, a, height*2, (i+f) & 1 ? BLUE : WHITE);
+	}
+	lcd_drawCircle(width/2, height/2, width, YELLOW);
+	lcd_setFontSize(2);
+	lcd_setFontBackground(BLACK);
+	char msg[24];
+	sprintf(msg, "frame %d", (int)f);
+	lcd_drawString(4, height-CLIP_MSG_H+2, msg, GREEN);
+	lcd_noFontBackground();
+	lcd_setFontSize(1);
+}
+
+int64_t test_lcd_setClip(void) {
+	int64_t startTick, endTick, diffTick, fullTick;
+
+	lcd_fillScreen(BLACK);
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < CLIP_FRAMES; f++) {
+		draw_clip_scene(f);
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+	fullTick = endTick - startTick;
+
+	// Redraw only the message area, the rest is rejected before rasterizing.
+	lcd_setClip(0, height-CLIP_MSG_H, width, CLIP_MSG_H);
+	startTick = esp_timer_get_time();
+	for (coord_t f = 0; f < CLIP_FRAMES; f++) {
+		draw_clip_scene(f);
+		lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+
+	// The same scene drawn with the origin moved, as a viewport.
+	lcd_setClip(width/4, height/4, width/2, height/2);
+	lcd_fillScreen(GRAY);
+	lcd_setOrigin(width/4, height/4);
+	draw_clip_scene(0);
+	lcd_setOrigin(0, 0);
+	lcd_resetClip();
+	lcd_writeFrame();
+
+	diffTick = endTick - startTick;
+	ESP_LOGI(__FUNCTION__, "time per frame[us] full:%"PRIi64" message area:%"PRIi64,
+		fullTick/CLIP_FRAMES, diffTick/CLIP_FRAMES);
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+int64_t test_lcd_frameDamage(void) {
+	int64_t startTick, endTick, diffTick;
+	frame_stats_t stats;
+	uint32_t bytes = 0;
+	const coord_t sz = 10;
+
+	if (lcd_getFrameBuffer() == NULL) return 0;
+	lcd_fillScreen(BLACK);
+	lcd_writeFrame();
+
+	startTick = esp_timer_get_time();
+	for (coord_t x = 0; x < width-sz; x += 2) {
+		lcd_fillRect(x, height/2, sz, sz, BLACK);
+		lcd_fillRect(x+2, height/2, sz, sz, YELLOW);
+		lcd_drawPixel(x, x % height, WHITE);
+		lcd_writeFrame();
+		lcd_getFrameStats(&stats);
+		bytes += stats.bytes;
+	}
+	endTick = esp_timer_get_time();
+
+	ESP_LOGI(__FUNCTION__, "bytes per frame:%lu", bytes/((width-sz)/2));
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
 int64_t test_lcd_wrapAround(void) {
 	int64_t startTick, endTick, diffTick;
 
@@ -773,7 +1404,196 @@ int64_t test_lcd_wrapAround(void) {
 	return diffTick;
 }
 
-// test_lcd_writeFrame
+// Same as test_lcd_wrapAround(), but 8 pixels per frame.
+int64_t test_lcd_wrapAroundN(void) {
+	int64_t startTick, endTick, diffTick;
+
+	if (lcd_getFrameBuffer() == NULL) return 0;
+	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
+
+	startTick = esp_timer_get_time();
+	for (coord_t i = 0; i < width/8; i++) {
+		lcd_wrapAroundN(SCROLL_RIGHT, height/4, height/4*3-1, 8); lcd_writeFrame();
+	}
+	for (coord_t i = 0; i < width/8; i++) {
+		lcd_wrapAroundN(SCROLL_LEFT, height/4, height/4*3-1, 8); lcd_writeFrame();
+	}
+	for (coord_t i = 0; i < height/8; i++) {
+		lcd_wrapAroundN(SCROLL_DOWN, width/4, width/4*3-1, 8); lcd_writeFrame();
+	}
+	for (coord_t i = 0; i < height/8; i++) {
+		lcd_wrapAroundN(SCROLL_UP, width/4, width/4*3-1, 8); lcd_writeFrame();
+	}
+	endTick = esp_timer_get_time();
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+int64_t test_lcd_writeFrame(void) {
+	int64_t startTick, endTick, diffTick;
+
+	if (lcd_getFrameBuffer() == NULL) return 0;
+	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
+
+	startTick = esp_timer_get_time();
+	lcd_frameDamage(0, 0, width, height);
+	lcd_writeFrame();
+	endTick = esp_timer_get_time();
+	ESP_LOGI(__FUNCTION__, "native order[us]:%"PRIi64,endTick-startTick);
+
+	lcd_frameSwapped(true);
+	startTick = esp_timer_get_time();
+	lcd_frameDamage(0, 0, width, height);
+	lcd_writeFrame();
+	endTick = esp_timer_get_time();
+	lcd_frameSwapped(false);
+
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+int64_t test_lcd_writeFrameAsync(void) {
+	int64_t startTick, endTick, diffTick;
+
+	if (lcd_getFrameBuffer() == NULL) return 0;
+	lcd_drawRGBBitmap(0, 0, peppers, PEPPERS_W, PEPPERS_H);
+
+	startTick = esp_timer_get_time();
+	lcd_writeFrameAsync();
+	endTick = esp_timer_get_time();
+
+	lcd_waitFrame();
+	ESP_LOGI(__FUNCTION__, "wait time[us]:%"PRIi64,esp_timer_get_time()-endTick);
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define KERN_LEN 70
+
+// Check the fill and copy kernels bit for bit against the per-pixel loops
+// they replace, at every alignment, then time a full frame fill with each.
+int64_t test_lcd_kernels(void) {
+	int64_t startTick, endTick, diffTick;
+	static uint16_t src[KERN_LEN+4], ref[KERN_LEN+4], out[KERN_LEN+4];
+	uint32_t errors = 0;
+
+	srand(1);
+	for (int32_t i = 0; i < KERN_LEN+4; i++) src[i] = rand();
+	for (int32_t off = 0; off < 2; off++) {
+		for (int32_t n = 0; n <= KERN_LEN; n++) {
+			uint16_t c = rand();
+			memset(ref, 0, sizeof(ref)); memset(out, 0, sizeof(out));
+			for (int32_t i = 0; i < n; i++) ref[off+i] = c;
+			kern_fill16(out+off, c, n);
+			errors += memcmp(ref, out, sizeof(ref)) != 0;
+
+			memset(ref, 0, sizeof(ref)); memset(out, 0, sizeof(out));
+			for (int32_t j = 0; j < 3; j++)
+				for (int32_t i = 0; i < n/3; i++) ref[off+j*(n/3+1)+i] = c;
+			kern_fill_rect16(out+off, n/3+1, n/3, 3, c);
+			errors += memcmp(ref, out, sizeof(ref)) != 0;
+
+			for (int32_t soff = 0; soff < 2; soff++) {
+				memset(ref, 0, sizeof(ref)); memset(out, 0, sizeof(out));
+				for (int32_t i = 0; i < n; i++) ref[off+i] = swap565(src[soff+i]);
+				kern_copy16_swap(out+off, src+soff, n);
+				errors += memcmp(ref, out, sizeof(ref)) != 0;
+
+				memset(ref, 0, sizeof(ref)); memset(out, 0, sizeof(out));
+				for (int32_t i = 0; i < n; i++) ref[off+i] = src[soff+i];
+				kern_copy16(out+off, src+soff, n);
+				errors += memcmp(ref, out, sizeof(ref)) != 0;
+			}
+		}
+	}
+	ESP_LOGI(__FUNCTION__, "mismatches:%lu", errors);
+
+	color_t *fb = lcd_getFrameBuffer();
+	if (fb == NULL) return 0;
+	size_t len = (size_t)width*height;
+
+	startTick = esp_timer_get_time();
+	for (size_t i = 0; i < len; i++) fb[i] = BLUE;
+	endTick = esp_timer_get_time();
+	ESP_LOGI(__FUNCTION__, "loop fill[us]:%"PRIi64,endTick-startTick);
+
+	startTick = esp_timer_get_time();
+	kern_fill16(fb, GREEN, len);
+	endTick = esp_timer_get_time();
+
+	lcd_writeFrame();
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+// Draw with a few colors into the indexed frame buffer, then cycle one
+// palette entry. Only available while the frame buffer is disabled.
+int64_t test_lcd_frameEnableIndexed(void) {
+	int64_t startTick, endTick, diffTick;
+
+	if (lcd_getFrameBuffer() != NULL) return 0;
+	lcd_frameEnableIndexed();
+
+	startTick = esp_timer_get_time();
+	lcd_fillScreen(BLACK);
+	for (int32_t i = 0; i < 16; i++) {
+		lcd_fillRect(0, i*height/16, width, height/32, (i & 1) ? RED : BLUE);
+	}
+	lcd_fillCircle(width/2, height/2, height/3, YELLOW);
+	lcd_drawString(width/2-24, height/2-4, "Indexed", BLACK);
+	lcd_writeFrame();
+	endTick = esp_timer_get_time();
+
+	uint8_t index = lcd_paletteIndex(YELLOW);
+	for (int32_t f = 0; f < 32; f++) {
+		lcd_paletteSet(index, rgb565(255, f*8, 0));
+		lcd_writeFrame();
+	}
+	lcd_frameDisable();
+
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
+
+#define BAND_LIST_SIZE (16*1024)
+
+// Redraw a whole scene each frame with band rendering, which is only
+// available while the frame buffer is disabled.
+int64_t test_lcd_bandEnable(void) {
+	int64_t startTick, endTick, diffTick;
+
+	if (lcd_getFrameBuffer() != NULL) return 0;
+	lcd_bandEnable(BAND_LIST_SIZE);
+
+	startTick = esp_timer_get_time();
+	for (int32_t f = 0; f < REPLAY_FRAMES; f++) {
+		lcd_fillScreen(BLACK);
+		lcd_drawRGBBitmap(f*4-PEPPERS_W, 0, peppers, PEPPERS_W, PEPPERS_H);
+		for (int32_t i = 0; i < REPLAY_OBJS; i++) {
+			coord_t x = i*width/REPLAY_OBJS;
+			coord_t y = (f*(i+1)) % height;
+			lcd_drawLine(x, 0, x+15, y, RED);
+			lcd_fillCircle(x+15, y, 12, YELLOW);
+		}
+		lcd_drawString(width/2-30, height-20, "Band mode", WHITE);
+		lcd_writeFrameAsync();
+	}
+	lcd_waitFrame();
+	endTick = esp_timer_get_time();
+
+	lcd_bandDisable();
+	ESP_LOGI(__FUNCTION__, "frame time[us]:%"PRIi64,(endTick-startTick)/REPLAY_FRAMES);
+	diffTick = endTick - startTick;
+	PRINT_TIME(diffTick);
+	return diffTick;
+}
 
 //----------------------------------------------------------------------------//
 // Test all
@@ -786,6 +1606,7 @@ void test_lcd_all(void *pvParameters)
 		test_lcd_colorBar(); WAIT;
 		test_lcd_colorBand(); WAIT;
 		test_lcd_fillScreen(); WAIT;
+		test_lcd_drawPixel(); WAIT;
 		test_lcd_drawHVLine(); WAIT;
 		test_lcd_drawLine(); WAIT;
 		test_lcd_drawRect(); WAIT;
@@ -794,23 +1615,44 @@ void test_lcd_all(void *pvParameters)
 		test_lcd_fillTriangle(); WAIT;
 		test_lcd_drawCircle(); WAIT;
 		test_lcd_fillCircle(); WAIT;
+		test_lcd_fillCircleExplode(); WAIT;
+		test_lcd_circleSpans(); WAIT;
 		test_lcd_drawRoundRect(); WAIT;
 		test_lcd_fillRoundRect(); WAIT;
 		test_lcd_drawArrow(); WAIT;
 		test_lcd_fillArrow(); WAIT;
 		test_lcd_drawBitmap(); WAIT;
+		test_lcd_drawBitmapBg(); WAIT;
 		test_lcd_drawRGBBitmap(); WAIT;
 		test_lcd_drawRect2(); WAIT;
 		test_lcd_fillRect2(); WAIT;
 		test_lcd_drawRoundRect2(); WAIT;
 		test_lcd_fillRoundRect2(); WAIT;
+		test_lcd_sinQ15(); WAIT;
 		test_lcd_drawRectC(); WAIT;
 		test_lcd_drawTriangleC(); WAIT;
 		test_lcd_drawRegularPolygonC(); WAIT;
+		test_lcd_fillRegularPolygonC(); WAIT;
+		test_lcd_fillPolygon(); WAIT;
 		test_lcd_drawString(); WAIT;
 		test_lcd_setFontDirection(); WAIT;
 		test_lcd_setFontSize(); WAIT;
+		test_lcd_scrollArea(); WAIT;
+		test_lcd_sprite(); WAIT;
+		test_lcd_tilemap(); WAIT;
+		test_lcd_compositor(); WAIT;
+		test_lcd_canvas(); WAIT;
+		test_lcd_canvasText(); WAIT;
+		test_lcd_setClip(); WAIT;
+		test_lcd_frameDamage(); WAIT;
+		test_lcd_frameDamageMode(); WAIT;
 		test_lcd_wrapAround(); WAIT;
+		test_lcd_wrapAroundN(); WAIT;
+		test_lcd_writeFrame(); WAIT;
+		test_lcd_writeFrameAsync(); WAIT;
+		test_lcd_kernels(); WAIT;
+		test_lcd_frameEnableIndexed(); WAIT;
+		test_lcd_bandEnable(); WAIT;
 		if (lcd_getFrameBuffer() == NULL) lcd_frameEnable();
 		else lcd_frameDisable();
 	}
@@ -20,7 +20,11 @@
 
 static SemaphoreHandle_t sema_h;
 static StaticSemaphore_t sema_buf;
-static coord_t xpos, ypos;
+static coord_t xpos, ypos; // cursor, ypos in rows from the top of the screen
+static coord_t first = -1; // text row in memory shown at the top, -1 before setup
+
+// Memory row that is shown at screen row y.
+#define MEM_ROW(y) (((y) + first) % ROWS)
 
 
 // Print formatted data from variable argument list to LCD.
@@ -34,6 +38,10 @@ int lcd_vprintf(const char* fmt, va_list args)
 
 	if (sema_h == NULL) sema_h = xSemaphoreCreateMutexStatic(&sema_buf);
 	xSemaphoreTake(sema_h, portMAX_DELAY);
+	if (first < 0) { // Scroll the text rows in hardware
+		lcd_scrollArea(0, ROWS * FONT_H);
+		first = 0;
+	}
 	lcd_setFontSize(FONT_SZ);
 	lcd_setFontBackground(FONT_BKG);
 	for (b = buf; (s = strpbrk(b, "\r\n")); b = s+1) { // Break into lines
@@ -42,20 +50,24 @@ int lcd_vprintf(const char* fmt, va_list args)
 		if (len) { // Length greater than zero
 			*s = '\0'; // Replace control char with NULL character
 			coord_t xs = xpos * FONT_W;
-			coord_t ys = ypos * FONT_H;
+			coord_t ys = MEM_ROW(ypos) * FONT_H;
 			lcd_drawString(xs, ys, b, FONT_CLR);
 		}
 		xpos = 0;
 		if (cc == '\n') {
-			if (++ypos >= ROWS) ypos = 0;
+			if (ypos < ROWS-1) ypos++;
+			else { // Scroll up one line
+				first = (first + 1) % ROWS;
+				lcd_scrollTo(first * FONT_H);
+			}
 			// Clear next line
-			lcd_fillRect(0, ypos * FONT_H, LCD_W, FONT_H, FONT_BKG);
+			lcd_fillRect(0, MEM_ROW(ypos) * FONT_H, LCD_W, FONT_H, FONT_BKG);
 		}
 	}
 	len = strlen(b);
 	if (len) { // Last segment without a newline.
 		coord_t xs = xpos * FONT_W;
-		coord_t ys = ypos * FONT_H;
+		coord_t ys = MEM_ROW(ypos) * FONT_H;
 		lcd_drawString(xs, ys, b, FONT_CLR);
 		xpos += len;
 	}